@@ -0,0 +1,305 @@
+#ifndef __BinaryUtil_hxx
+#define __BinaryUtil_hxx
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "StringUtil.hxx"
+
+namespace ctkCLI {
+
+/**
+ * Binary representation of parameter values.
+ *
+ * Values are stored in native byte order. Scalars are stored as is, strings
+ * as their characters and numeric vectors as arrays of their elements, so
+ * that they can be used in place. A string vector is stored as its size,
+ * the lengths of its items (all uint64_t) and the concatenated items.
+ * Types without a binary representation are stored as text (type code 0).
+ **/
+template <typename T> inline int binaryType() { return 0; }
+
+#define CTK_DEFINE_BINARY_TYPE(TYPE,CODE) template<> inline int binaryType<TYPE>() {return CODE;}
+CTK_DEFINE_BINARY_TYPE(bool,1)
+CTK_DEFINE_BINARY_TYPE(int,2)
+CTK_DEFINE_BINARY_TYPE(float,3)
+CTK_DEFINE_BINARY_TYPE(double,4)
+CTK_DEFINE_BINARY_TYPE(std::string,5)
+CTK_DEFINE_BINARY_TYPE(std::vector<int>,6)
+CTK_DEFINE_BINARY_TYPE(std::vector<float>,7)
+CTK_DEFINE_BINARY_TYPE(std::vector<double>,8)
+CTK_DEFINE_BINARY_TYPE(std::vector<std::string>,9)
+
+/// Append the binary representation of a value to out
+template <typename T> inline void binaryWrite(std::string& out, const T& in) { out+=toString(in); }
+
+/// Set value from its binary representation. Returns false and leaves value unchanged if in has the wrong size.
+template <typename T> inline bool binaryRead(std::string_view in, T& value) { return stringTo(in,value); }
+
+/// Scalars are stored as they are in memory
+template <typename T> inline void binaryWriteScalar(std::string& out, const T& in) { out.append(reinterpret_cast<const char*>(&in),sizeof(T)); }
+template <typename T> inline bool binaryReadScalar(std::string_view in, T& value)
+{
+  if (in.length()!=sizeof(T)) return false;
+  std::memcpy(&value,in.data(),sizeof(T));
+  return true;
+}
+
+/// Numeric vectors are stored as a plain array
+template <typename T> inline void binaryWriteArray(std::string& out, const std::vector<T>& in)
+{
+  if (!in.empty()) out.append(reinterpret_cast<const char*>(&in[0]),in.size()*sizeof(T));
+}
+template <typename T> inline bool binaryReadArray(std::string_view in, std::vector<T>& value)
+{
+  if (in.length()%sizeof(T)!=0) return false;
+  value.resize(in.length()/sizeof(T));
+  if (!value.empty()) std::memcpy(&value[0],in.data(),in.length());
+  return true;
+}
+
+template <> inline void binaryWrite<>(std::string& out, const bool& in) { out.push_back(in ? 1 : 0); }
+template <> inline bool binaryRead<>(std::string_view in, bool& value)
+{
+  if (in.length()!=1) return false;
+  value=in[0]!=0;
+  return true;
+}
+template <> inline void binaryWrite<>(std::string& out, const int& in) { binaryWriteScalar(out,in); }
+template <> inline bool binaryRead<>(std::string_view in, int& value) { return binaryReadScalar(in,value); }
+template <> inline void binaryWrite<>(std::string& out, const float& in) { binaryWriteScalar(out,in); }
+template <> inline bool binaryRead<>(std::string_view in, float& value) { return binaryReadScalar(in,value); }
+template <> inline void binaryWrite<>(std::string& out, const double& in) { binaryWriteScalar(out,in); }
+template <> inline bool binaryRead<>(std::string_view in, double& value) { return binaryReadScalar(in,value); }
+template <> inline void binaryWrite<>(std::string& out, const std::string& in) { out+=in; }
+template <> inline bool binaryRead<>(std::string_view in, std::string& value) { value.assign(in.data(),in.length()); return true; }
+template <> inline void binaryWrite<>(std::string& out, const std::vector<int>& in) { binaryWriteArray(out,in); }
+template <> inline bool binaryRead<>(std::string_view in, std::vector<int>& value) { return binaryReadArray(in,value); }
+template <> inline void binaryWrite<>(std::string& out, const std::vector<float>& in) { binaryWriteArray(out,in); }
+template <> inline bool binaryRead<>(std::string_view in, std::vector<float>& value) { return binaryReadArray(in,value); }
+template <> inline void binaryWrite<>(std::string& out, const std::vector<double>& in) { binaryWriteArray(out,in); }
+template <> inline bool binaryRead<>(std::string_view in, std::vector<double>& value) { return binaryReadArray(in,value); }
+
+template <> inline void binaryWrite<>(std::string& out, const std::vector<std::string>& in)
+{
+  binaryWriteScalar(out,(std::uint64_t)in.size());
+  for (std::size_t i=0;i<in.size();i++)
+    binaryWriteScalar(out,(std::uint64_t)in[i].length());
+  for (std::size_t i=0;i<in.size();i++)
+    out+=in[i];
+}
+template <> inline bool binaryRead<>(std::string_view in, std::vector<std::string>& value)
+{
+  std::uint64_t n;
+  if (in.length()<sizeof(n)) return false;
+  std::memcpy(&n,in.data(),sizeof(n));
+  if ((in.length()-sizeof(n))/sizeof(n)<n) return false;
+  std::vector<std::string> ret((std::size_t)n);
+  std::size_t offset=sizeof(n)*(1+(std::size_t)n);
+  for (std::size_t i=0;i<ret.size();i++)
+  {
+    std::uint64_t length;
+    std::memcpy(&length,in.data()+sizeof(n)*(1+i),sizeof(length));
+    if (length>in.length()-offset) return false;
+    ret[i].assign(in.data()+offset,(std::size_t)length);
+    offset+=(std::size_t)length;
+  }
+  if (offset!=in.length()) return false;
+  value.swap(ret);
+  return true;
+}
+
+/**
+ * Layout of a binary parameter file (all offsets relative to the beginning of the file):
+ *
+ * - ctkBinaryHeader
+ * - ctkBinaryEntry for each parameter, sorted by name
+ * - names and values. Each value starts at a multiple of 8 bytes.
+ *
+ * A file written on a machine with different byte order is rejected, since its version does not match.
+ **/
+struct ctkBinaryHeader
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t count;
+  /// Incremented whenever the file is rewritten in place
+  std::uint64_t generation;
+  /// Size of the complete file in bytes
+  std::uint64_t size;
+};
+
+struct ctkBinaryEntry
+{
+  std::uint64_t nameOffset;
+  std::uint64_t valueOffset;
+  std::uint64_t valueLength;
+  std::uint32_t nameLength;
+  /// See binaryType<T>()
+  std::uint32_t type;
+};
+
+const char ctkBinaryMagic[8]={'C','T','K','P','A','R','A','M'};
+const std::uint32_t ctkBinaryVersion=1;
+
+/// Collects values and creates the contents of a binary parameter file
+class ctkBinaryWriter
+{
+  struct Item
+  {
+    std::string name;
+    std::uint32_t type;
+    std::string value;
+    bool operator<(const Item& other) const { return name<other.name; }
+  };
+  std::vector<Item> items;
+
+public:
+  /// Add a value. value receives the binary representation of its value (see binaryWrite).
+  std::string& add(std::string_view name, int type)
+  {
+    items.push_back(Item());
+    items.back().name=name;
+    items.back().type=(std::uint32_t)type;
+    return items.back().value;
+  }
+
+  /// The contents of the file
+  std::string str(std::uint64_t generation=0)
+  {
+    std::sort(items.begin(),items.end());
+    std::size_t tableEnd=sizeof(ctkBinaryHeader)+items.size()*sizeof(ctkBinaryEntry);
+    std::string out(tableEnd,'\0');
+    std::vector<ctkBinaryEntry> entries(items.size());
+    for (std::size_t i=0;i<items.size();i++)
+    {
+      entries[i].nameOffset=out.length();
+      entries[i].nameLength=(std::uint32_t)items[i].name.length();
+      out+=items[i].name;
+      out.resize((out.length()+7)&~(std::size_t)7,'\0');
+      entries[i].valueOffset=out.length();
+      entries[i].valueLength=items[i].value.length();
+      entries[i].type=items[i].type;
+      out+=items[i].value;
+    }
+    ctkBinaryHeader header;
+    std::memcpy(header.magic,ctkBinaryMagic,sizeof(header.magic));
+    header.version=ctkBinaryVersion;
+    header.count=(std::uint32_t)items.size();
+    header.generation=generation;
+    header.size=out.length();
+    std::memcpy(&out[0],&header,sizeof(header));
+    if (!entries.empty())
+      std::memcpy(&out[sizeof(header)],&entries[0],entries.size()*sizeof(ctkBinaryEntry));
+    return out;
+  }
+};
+
+/// Access to the contents of a binary parameter file in place
+class ctkBinaryReader
+{
+  std::string_view data;
+  ctkBinaryHeader header;
+
+  ctkBinaryEntry entry(int i) const
+  {
+    ctkBinaryEntry e;
+    std::memcpy(&e,data.data()+sizeof(ctkBinaryHeader)+i*sizeof(e),sizeof(e));
+    return e;
+  }
+
+public:
+  ctkBinaryReader() { header.count=0; }
+
+  /// Use the contents of a file. Returns false if it is not a valid binary parameter file. data must stay valid during use.
+  bool open(std::string_view contents)
+  {
+    data=std::string_view();
+    header.count=0;
+    if (contents.length()<sizeof(ctkBinaryHeader)) return false;
+    ctkBinaryHeader h;
+    std::memcpy(&h,contents.data(),sizeof(h));
+    if (std::memcmp(h.magic,ctkBinaryMagic,sizeof(h.magic))!=0 || h.version!=ctkBinaryVersion || h.size!=contents.length())
+      return false;
+    if ((contents.length()-sizeof(h))/sizeof(ctkBinaryEntry)<h.count) return false;
+    // the entries must not point outside of the file
+    for (std::uint32_t i=0;i<h.count;i++)
+    {
+      ctkBinaryEntry e;
+      std::memcpy(&e,contents.data()+sizeof(h)+i*sizeof(e),sizeof(e));
+      if (e.nameOffset>h.size || e.nameLength>h.size-e.nameOffset || e.valueOffset>h.size || e.valueLength>h.size-e.valueOffset)
+        return false;
+    }
+    data=contents;
+    header=h;
+    return true;
+  }
+
+  /// Number of values
+  int size() const { return (int)header.count; }
+
+  /// The generation of the file (see ctkBinaryHeader)
+  std::uint64_t generation() const { return header.count ? header.generation : 0; }
+
+  std::string_view name(int i) const { ctkBinaryEntry e=entry(i); return data.substr((std::size_t)e.nameOffset,e.nameLength); }
+  int type(int i) const { return (int)entry(i).type; }
+  /// The binary representation of value i (see binaryRead)
+  std::string_view value(int i) const { ctkBinaryEntry e=entry(i); return data.substr((std::size_t)e.valueOffset,(std::size_t)e.valueLength); }
+
+  /// Index of the value by name or -1
+  int find(std::string_view n) const
+  {
+    int lo=0, hi=size();
+    while (lo<hi)
+    {
+      int mid=(lo+hi)/2;
+      if (name(mid)<n) lo=mid+1;
+      else hi=mid;
+    }
+    return lo<size() && name(lo)==n ? lo : -1;
+  }
+};
+
+/// 64 bit FNV-1a hash of the contents of a binary parameter file, eg. as a key for caching results computed from its values
+inline std::uint64_t binaryHash(std::string_view contents)
+{
+  std::uint64_t h=14695981039346656037ull;
+  for (std::size_t i=0;i<contents.length();i++)
+    h=(h^(unsigned char)contents[i])*1099511628211ull;
+  return h;
+}
+
+/// Names of the values which differ between the contents of two binary parameter files, including those only in one of them.
+/// Values of different type differ. Invalid contents count as empty.
+inline std::vector<std::string> binaryDiff(std::string_view a, std::string_view b)
+{
+  ctkBinaryReader ra, rb;
+  ra.open(a);
+  rb.open(b);
+  std::vector<std::string> names;
+  // both are sorted by name
+  for (int i=0, j=0; i<ra.size() || j<rb.size(); )
+  {
+    int order=i>=ra.size() ? 1 : (j>=rb.size() ? -1 : ra.name(i).compare(rb.name(j)));
+    if (order<0)
+      names.push_back(std::string(ra.name(i++)));
+    else if (order>0)
+      names.push_back(std::string(rb.name(j++)));
+    else
+    {
+      if (ra.type(i)!=rb.type(j) || ra.value(i)!=rb.value(j))
+        names.push_back(std::string(ra.name(i)));
+      i++;
+      j++;
+    }
+  }
+  return names;
+}
+
+} // namespace ctkCLI
+
+#endif // __BinaryUtil_hxx
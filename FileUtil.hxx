@@ -0,0 +1,129 @@
+#ifndef __FileUtil_hxx
+#define __FileUtil_hxx
+
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ctkCLI {
+
+/// Read-only access to the complete contents of a file. The file is memory mapped where supported, else it is read into memory.
+class ctkMappedFile
+{
+  const char* ptr;
+  std::size_t len;
+  bool mapped;
+  bool good;
+  /// Holds the contents where the file could not be mapped
+  std::string buffer;
+
+  ctkMappedFile(const ctkMappedFile&);
+  ctkMappedFile& operator=(const ctkMappedFile&);
+
+public:
+  ctkMappedFile(const std::string& path) : ptr(0x0), len(0), mapped(false), good(false)
+  {
+#ifndef _WIN32
+    int fd=::open(path.c_str(),O_RDONLY);
+    if (fd<0) return;
+    struct stat st;
+    if (::fstat(fd,&st)==0 && S_ISREG(st.st_mode))
+    {
+      good=true;
+      len=(std::size_t)st.st_size;
+      if (len>0)
+      {
+        void* p=::mmap(0x0,len,PROT_READ,MAP_PRIVATE,fd,0);
+        if (p!=MAP_FAILED)
+        {
+          ptr=static_cast<const char*>(p);
+          mapped=true;
+        }
+        else
+          good=false;
+      }
+    }
+    ::close(fd);
+    if (good) return;
+#endif
+    // Fallback: read complete contents of file into buffer
+    std::ifstream file(path.c_str(),std::ios::in|std::ios::binary);
+    if (!file.is_open() || !file.good())
+      return;
+    buffer.assign(std::istreambuf_iterator<char>(file),std::istreambuf_iterator<char>());
+    ptr=buffer.data();
+    len=buffer.length();
+    good=true;
+  }
+
+  ~ctkMappedFile()
+  {
+#ifndef _WIN32
+    if (mapped) ::munmap(const_cast<char*>(ptr),len);
+#endif
+  }
+
+  /// False, if the file could not be opened
+  bool is_open() const { return good; }
+
+  /// The contents of the file. Valid as long as this object lives.
+  std::string_view data() const { return std::string_view(ptr,len); }
+
+  /// Read all pages of a mapped file into memory now rather than on first access, eg. in a background thread
+  void prefetch() const
+  {
+#ifndef _WIN32
+    if (!mapped) return;
+    ::madvise(const_cast<char*>(ptr),len,MADV_WILLNEED);
+    // touch one byte per page, so that the reads happen here
+    const volatile char* p=ptr;
+    for (std::size_t i=0;i<len;i+=4096)
+      (void)p[i];
+#endif
+  }
+};
+
+/// Opens and reads several files concurrently in the background, so that their latencies (eg. on network storage) overlap.
+/// take(i) only waits for file i, thus the files can be processed in order, each as soon as it has arrived.
+/// The files are memory mapped: they must not be written until they have been processed.
+class ctkFilePrefetch
+{
+  std::vector<std::future<std::unique_ptr<ctkMappedFile> > > files;
+
+  ctkFilePrefetch(const ctkFilePrefetch&);
+  ctkFilePrefetch& operator=(const ctkFilePrefetch&);
+
+  static std::unique_ptr<ctkMappedFile> read(const std::string& path)
+  {
+    std::unique_ptr<ctkMappedFile> file(new ctkMappedFile(path));
+    file->prefetch();
+    return file;
+  }
+
+public:
+  ctkFilePrefetch(const std::vector<std::string>& paths)
+  {
+    for (std::size_t i=0;i<paths.size();i++)
+      files.push_back(std::async(std::launch::async,read,paths[i]));
+  }
+
+  std::size_t size() const { return files.size(); }
+
+  /// File i, once it has been read. May only be taken once.
+  std::unique_ptr<ctkMappedFile> take(std::size_t i) { return files[i].get(); }
+};
+
+} // namespace ctkCLI
+
+#endif // __FileUtil_hxx
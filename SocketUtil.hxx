@@ -0,0 +1,238 @@
+#ifndef __SocketUtil_hxx
+#define __SocketUtil_hxx
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "BinaryUtil.hxx"
+#include "StringUtil.hxx"
+
+namespace ctkCLI {
+
+/**
+ * A connection which exchanges requests and responses, eg. stdin/stdout or a socket.
+ *
+ * A request is either the contents of a binary parameter file (see BinaryUtil.hxx),
+ * recognized by its magic number, or text up to a line "---".
+ **/
+class ctkRequestStream
+{
+  /// File descriptors for input and output or -1 to use std::cin/std::cout
+  int in, out;
+  bool owned;
+  std::string buffer;
+  bool eof;
+
+  ctkRequestStream(const ctkRequestStream&);
+  ctkRequestStream& operator=(const ctkRequestStream&);
+
+  /// Read more input into buffer. Returns false at end of input.
+  bool fill()
+  {
+    if (eof) return false;
+    char chunk[4096];
+    std::size_t n=0;
+#ifndef _WIN32
+    if (in>=0)
+    {
+      ssize_t r;
+      do r=::read(in,chunk,sizeof(chunk)); while (r<0 && errno==EINTR);
+      n=r>0 ? (std::size_t)r : 0;
+    }
+    else
+#endif
+    {
+      // one line at a time, so that interactive use does not block
+      std::string line;
+      if (std::getline(std::cin,line))
+      {
+        line.push_back('\n');
+        buffer+=line;
+        return true;
+      }
+    }
+    if (n==0) eof=true;
+    buffer.append(chunk,n);
+    return n>0;
+  }
+
+public:
+  /// Requests from stdin, responses to stdout. Where there are no file descriptors, std::cin is read by line (text only).
+#ifndef _WIN32
+  ctkRequestStream() : in(0), out(1), owned(false), eof(false) {}
+#else
+  ctkRequestStream() : in(-1), out(-1), owned(false), eof(false) {}
+#endif
+  /// Requests and responses through a file descriptor, eg. a socket. It is closed on destruction.
+  ctkRequestStream(int fd) : in(fd), out(fd), owned(true), eof(false) {}
+  ~ctkRequestStream()
+  {
+#ifndef _WIN32
+    if (owned && in>=0) ::close(in);
+#endif
+  }
+
+  /// Read the next request. Returns false at end of input. binary is true for the contents of a binary parameter file.
+  bool next(std::string& request, bool& binary)
+  {
+    for (std::size_t pos=0;;)
+    {
+      binary=buffer.length()>=sizeof(ctkBinaryMagic) && std::memcmp(buffer.data(),ctkBinaryMagic,sizeof(ctkBinaryMagic))==0;
+      if (binary && buffer.length()>=sizeof(ctkBinaryHeader))
+      {
+        // the size of binary requests is known from their header
+        ctkBinaryHeader header;
+        std::memcpy(&header,buffer.data(),sizeof(header));
+        // (an invalid size still consumes the header, which is then rejected as a request)
+        std::size_t size=header.size<sizeof(header) ? sizeof(header) : (std::size_t)header.size;
+        if (buffer.length()>=size)
+        {
+          request.assign(buffer,0,size);
+          buffer.erase(0,size);
+          return true;
+        }
+      }
+      else if (!binary)
+      {
+        // text up to a line "---"
+        for (std::size_t end=buffer.find('\n',pos);end!=std::string::npos;pos=end+1,end=buffer.find('\n',pos))
+          if (trimmed(std::string_view(buffer).substr(pos,end-pos)," \t\r")=="---")
+          {
+            request.assign(buffer,0,pos);
+            buffer.erase(0,end+1);
+            return true;
+          }
+      }
+      if (!fill())
+      {
+        // the last request may end with the input
+        if (trimmed(buffer," \t\r\n").empty()) return false;
+        request.swap(buffer);
+        buffer.clear();
+        binary=false;
+        return true;
+      }
+    }
+  }
+
+  /// Send a response
+  void write(std::string_view response)
+  {
+    // output of the application to std::cout goes first
+    std::cout.flush();
+#ifndef _WIN32
+    if (out>=0)
+    {
+      while (!response.empty())
+      {
+        ssize_t r=::write(out,response.data(),response.length());
+        if (r<0 && errno==EINTR) continue;
+        if (r<=0) return;
+        response.remove_prefix((std::size_t)r);
+      }
+      return;
+    }
+#endif
+    std::cout.write(response.data(),response.length());
+    std::cout.flush();
+  }
+};
+
+#ifndef _WIN32
+/// Listening Unix domain socket. The socket file is removed on destruction.
+class ctkUnixServer
+{
+  int fd;
+  std::string path;
+  /// Identity of the socket file this server bound, so that only that one is removed
+  dev_t device;
+  ino_t inode;
+
+  ctkUnixServer(const ctkUnixServer&);
+  ctkUnixServer& operator=(const ctkUnixServer&);
+
+public:
+  /// Create a socket at path and listen on it. An existing socket file at path is replaced, any other file is left alone and fails.
+  ctkUnixServer(const std::string& p) : fd(-1), path(p), device(0), inode(0)
+  {
+    sockaddr_un addr;
+    if (path.length()>=sizeof(addr.sun_path)) return;
+    std::memset(&addr,0,sizeof(addr));
+    addr.sun_family=AF_UNIX;
+    std::memcpy(addr.sun_path,path.c_str(),path.length());
+    struct stat st;
+    if (::lstat(path.c_str(),&st)==0)
+    {
+      if (!S_ISSOCK(st.st_mode))
+      {
+        std::cerr << "Not replacing " << path << ": it exists and is not a socket" << std::endl;
+        return;
+      }
+      ::unlink(path.c_str());
+    }
+    fd=::socket(AF_UNIX,SOCK_STREAM,0);
+    if (fd<0) return;
+    if (::bind(fd,reinterpret_cast<sockaddr*>(&addr),sizeof(addr))!=0)
+    {
+      ::close(fd);
+      fd=-1;
+      return;
+    }
+    if (::lstat(path.c_str(),&st)==0)
+    {
+      device=st.st_dev;
+      inode=st.st_ino;
+    }
+    if (::listen(fd,16)!=0)
+    {
+      ::close(fd);
+      fd=-1;
+      removeSocket();
+    }
+  }
+
+  ~ctkUnixServer()
+  {
+    if (fd<0) return;
+    ::close(fd);
+    removeSocket();
+  }
+
+  /// False, if the socket could not be created
+  bool is_open() const { return fd>=0; }
+
+  /// Wait for the next connection. Returns its file descriptor or -1 on errors. Interruptions by signals
+  /// and connections aborted by the client before they were accepted are no errors: it waits for the next one.
+  int accept()
+  {
+    if (fd<0) return -1;
+    int c;
+    do c=::accept(fd,0x0,0x0); while (c<0 && (errno==EINTR || errno==ECONNABORTED));
+    return c;
+  }
+
+private:
+  /// Remove the socket file, if it still is the one bound by this server
+  void removeSocket()
+  {
+    struct stat st;
+    if (::lstat(path.c_str(),&st)==0 && S_ISSOCK(st.st_mode) && st.st_dev==device && st.st_ino==inode)
+      ::unlink(path.c_str());
+  }
+};
+#endif
+
+} // namespace ctkCLI
+
+#endif // __SocketUtil_hxx
@@ -1,12 +1,50 @@
 #ifndef __StringUtil_hxx
 #define __StringUtil_hxx
 
+#include <bitset>
+#include <charconv>
 #include <iostream>
 #include <sstream>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace ctkCLI {
 
+/// A view of str without leading and trailing characters from t
+inline std::string_view trimmed(std::string_view str, std::string_view t = " \t")
+{
+  std::string_view::size_type first=str.find_first_not_of(t);
+  if (first==std::string_view::npos) return std::string_view();
+  return str.substr(first,str.find_last_not_of(t)-first+1);
+}
+
+/// Locale independent conversion of a number. Fails on anything but surrounding white space.
+template <typename T> inline bool numberFromChars(std::string_view in, T& value)
+{
+  in=trimmed(in," \t\r\n");
+  // std::from_chars does not accept a leading '+'
+  if (in.length()>1 && in[0]=='+' && in[1]!='-') in.remove_prefix(1);
+  T v;
+  std::from_chars_result r=std::from_chars(in.data(),in.data()+in.length(),v);
+  if (r.ec!=std::errc() || r.ptr!=in.data()+in.length())
+    return false;
+  value=v;
+  return true;
+}
+
+/// Locale independent, shortest representation of a number, which converts back to exactly the same value.
+template <typename T> inline std::string numberToChars(const T& in)
+{
+  char buffer[32];
+  std::to_chars_result r=std::to_chars(buffer,buffer+sizeof(buffer),in);
+  return std::string(buffer,r.ptr);
+}
+
 template <typename T> inline std::string toString(const T& in)
 {
   std::ostringstream strstr;
@@ -14,22 +52,33 @@ template <typename T> inline std::string toString(const T& in)
   return strstr.str();
 }
 
-template <typename T> inline T stringTo(const std::string& in)
+/// Convert a string to a value of type T. Returns false and leaves value unchanged if the string does not represent a T.
+template <typename T> inline bool stringTo(std::string_view in, T& value)
 {
-  T value;
-  std::istringstream strstr(in);
-  strstr >> value;
-  return value;
+  T v;
+  std::istringstream strstr{std::string(in)};
+  if (!(strstr >> v)) return false;
+  value=v;
+  return true;
 }
 
 template <> inline std::string toString<>(const std::string& in) { return in; }
-template <> inline std::string stringTo<>(const std::string& in) { return in; }
+template <> inline bool stringTo<>(std::string_view in, std::string& value) { value.assign(in.data(),in.length()); return true; }
+template <> inline std::string toString<>(const int& in) { return numberToChars(in); }
+template <> inline bool stringTo<>(std::string_view in, int& value) { return numberFromChars(in,value); }
+template <> inline std::string toString<>(const float& in) { return numberToChars(in); }
+template <> inline bool stringTo<>(std::string_view in, float& value) { return numberFromChars(in,value); }
+template <> inline std::string toString<>(const double& in) { return numberToChars(in); }
+template <> inline bool stringTo<>(std::string_view in, double& value) { return numberFromChars(in,value); }
 template <> inline std::string toString<>(const bool& in) { return in ? "true" : "false"; }
-template <> inline bool stringTo<>(const std::string& in)
+template <> inline bool stringTo<>(std::string_view in, bool& value)
 {
-  if (in=="true" || in=="yes") return true;
-  if (in=="false" || in=="no") return false;
-  return stringTo<int>(in)>0;
+  if (in=="true" || in=="yes") { value=true; return true; }
+  if (in=="false" || in=="no") { value=false; return true; }
+  int i;
+  if (!numberFromChars(in,i)) return false;
+  value=i>0;
+  return true;
 }
 
 template <typename T> inline std::string vectortoString(const std::vector<T>& in, const std::string& delim=" ")
@@ -42,28 +91,71 @@ template <typename T> inline std::string vectortoString(const std::vector<T>& in
   return ret;
 }
 
+/// Number of occurrences of c in str. Long strings are scanned 16 characters at a time, if SSE2 is available.
+inline std::size_t countChar(std::string_view str, char c)
+{
+  std::size_t n=0, i=0;
+#ifdef __SSE2__
+  const __m128i needle=_mm_set1_epi8(c);
+  for (;i+16<=str.length();i+=16)
+  {
+    __m128i chunk=_mm_loadu_si128(reinterpret_cast<const __m128i*>(str.data()+i));
+    n+=std::bitset<16>((unsigned long)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk,needle))).count();
+  }
+#endif
+  for (;i<str.length();i++)
+    if (str[i]==c) n++;
+  return n;
+}
+
+/// Convert a delimited list to a vector. An empty last item is ignored. Returns false if any item does not represent a T (which is then default-initialized).
+template <typename T> inline bool stringToVector(std::string_view in, std::vector<T>& out, const char delim=' ')
+{
+  bool ok=true;
+  out.clear();
+  out.reserve(countChar(in,delim)+1);
+  // items are converted right from the input, without copying them
+  for (std::string_view::size_type pos=0;;)
+  {
+    std::string_view::size_type next=in.find(delim,pos);
+    std::string_view item=in.substr(pos,next==std::string_view::npos ? next : next-pos);
+    if (next==std::string_view::npos && item.empty())
+      break;
+    out.push_back(T());
+    ok=stringTo(item,out.back()) && ok;
+    if (next==std::string_view::npos)
+      break;
+    pos=next+1;
+  }
+  return ok;
+}
+
 template <typename T> inline std::vector<T> stringToVector(const std::string& in, const char delim=' ')
 {
-  std::string item;
   std::vector<T> ret;
-  std::istringstream str(in);
-  for (;std::getline(str,item,delim);str&&!str.eof())
-    ret.push_back(stringTo<T>(item));
-  if (item.empty()) ret.pop_back();
+  stringToVector(in,ret,delim);
   return ret;
 }
 
 template <> inline std::string toString<>(const std::vector<int>& in) {return vectortoString<int>(in,",");}
-template <> inline std::vector<int> stringTo<>(const std::string& in) {return stringToVector<int>(in,',');}
+template <> inline bool stringTo<>(std::string_view in, std::vector<int>& value) {return stringToVector<int>(in,value,',');}
 
 template <> inline std::string toString<>(const std::vector<float>& in) {return vectortoString<float>(in,",");}
-template <> inline std::vector<float> stringTo<>(const std::string& in) {return stringToVector<float>(in,',');}
+template <> inline bool stringTo<>(std::string_view in, std::vector<float>& value) {return stringToVector<float>(in,value,',');}
 
 template <> inline std::string toString<>(const std::vector<double>& in) {return vectortoString<double>(in,",");}
-template <> inline std::vector<double> stringTo<>(const std::string& in) {return stringToVector<double>(in,',');}
+template <> inline bool stringTo<>(std::string_view in, std::vector<double>& value) {return stringToVector<double>(in,value,',');}
 
 template <> inline std::string toString<>(const std::vector<std::string>& in) {return vectortoString<std::string>(in,",");}
-template <> inline std::vector<std::string> stringTo<>(const std::string& in) {return stringToVector<std::string>(in,',');}
+template <> inline bool stringTo<>(std::string_view in, std::vector<std::string>& value) {return stringToVector<std::string>(in,value,',');}
+
+/// Convert a string to a value of type T. Returns a default-initialized T if the string does not represent a T.
+template <typename T> inline T stringTo(std::string_view in)
+{
+  T value=T();
+  stringTo(in,value);
+  return value;
+}
 
 inline void rtrim(std::string &str , const std::string& t = " \t")
 {
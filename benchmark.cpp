@@ -0,0 +1,298 @@
+#define CTK_CLI_PROFILING_NO_ALLOC_HOOKS
+#include "ctkParam.hxx"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+CTK_INSTANTIATE_CMD_LINE_APP("CmdLineParamsBenchmark", "Measures the cost of the parameter handling.");
+
+// Usage: CmdLineParamsBenchmark [group...]
+// Runs the named groups of benchmarks in this process. Without arguments, each group runs in a process
+// of its own, so that the parameters declared by one group do not affect the measurements of the others.
+
+// All heap allocations are counted, so that benchmarks can report memory use (see ctkCLI::ctkProfileCounters).
+// The hooks are defined here rather than by CTK_INSTANTIATE_CMD_LINE_APP, so that they are there without CTK_CLI_PROFILING as well.
+CTK_PROFILE_DEFINE_ALLOCATION_HOOKS
+
+// Results are printed as one JSON object per line. n is the problem size (number of parameters or items).
+// The benchmarks, their order, sizes and units are fixed, so that the output of two runs can be compared line by line.
+void report(const std::string& benchmark, int n, const std::string& unit, double value)
+{
+ std::cout << "{\"benchmark\":\"" << benchmark << "\",\"n\":" << n
+           << ",\"" << unit << "\":" << value << "}" << std::endl;
+}
+
+// Wall time since start in nanoseconds
+double elapsed(const std::chrono::steady_clock::time_point& start)
+{
+ return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count();
+}
+
+// Number of parameters of the synthetic schemas
+const int schemaSizes[]={10,100,1000,10000};
+const int numSchemaSizes=4;
+
+std::string paramKey(int i)
+{
+ return "Param "+ctkCLI::toString(i);
+}
+
+// Declare parameters from..to-1 of a synthetic schema in section, with types and descriptions as a typical app has them
+void declareSchema(const std::string& section, int from, int to)
+{
+ for (int i=from;i<to;i++)
+ {
+  std::string key=paramKey(i);
+  switch (i%4)
+  {
+   case 0: ctkParam<int>(section,key).declare("An integer parameter"); break;
+   case 1: ctkParam<double>(section,key).declare("A double parameter"); break;
+   case 2: ctkParamFile(section,key).setFileExtensions(".nrrd").declare("A file parameter"); break;
+   case 3: ctkParam<bool>(section,key).declare("A boolean parameter"); break;
+  }
+ }
+}
+
+// Heap memory in use after declaring n parameters with description and flags, as a typical app does.
+// allocations_per_param counts all allocations, including temporary ones.
+void benchmarkDeclarationMemory(int n)
+{
+ std::uint64_t bytes=ctkCLI::ctkProfileCounters::bytesInUse, allocations=ctkCLI::ctkProfileCounters::allocations;
+ declareSchema("Memory",0,n);
+ report("declarationMemory",n,"bytes_per_param",(double)(ctkCLI::ctkProfileCounters::bytesInUse-bytes)/n);
+ report("declarationMemory",n,"allocations_per_param",(double)(ctkCLI::ctkProfileCounters::allocations-allocations)/n);
+}
+
+// Time to declare a schema of n parameters
+void benchmarkDeclaration(int n)
+{
+ auto start=std::chrono::steady_clock::now();
+ declareSchema("Declaration "+ctkCLI::toString(n),0,n);
+ report("declaration",n,"ns_per_param",elapsed(start)/n);
+}
+
+// Parsing of a command line that sets each of n parameters of mixed types
+void benchmarkParseCommandLine(int n)
+{
+ std::string section="Parse "+ctkCLI::toString(n);
+ std::vector<std::string> args(1,"benchmark");
+ for (int i=0;i<n;i++)
+ {
+  std::string key=paramKey(i);
+  std::string flag="--"+ctkCLI::normName(section,key);
+  switch (i%4)
+  {
+   case 0: ctkParam<int>(section,key)=0;            args.push_back(flag); args.push_back(ctkCLI::toString(i)); break;
+   case 1: ctkParam<double>(section,key)=0;         args.push_back(flag); args.push_back("0.125"); break;
+   case 2: ctkParam<std::string>(section,key)="";   args.push_back(flag); args.push_back("/some/path/to/a/file.nrrd"); break;
+   case 3: ctkParam<bool>(section,key)=false;       args.push_back(flag); break;
+  }
+ }
+ int numArgs=(int)args.size()-1;
+ int repetitions=1+200000/numArgs;
+ std::vector<char*> argv(args.size()+1,(char*)0x0);
+ auto start=std::chrono::steady_clock::now();
+ for (int r=0;r<repetitions;r++)
+ {
+  for (int i=0;i<(int)args.size();i++) argv[i]=&args[i][0];
+  int argc=(int)args.size();
+  ctkApp.parseCommandLine(&argc,&argv[0]);
+ }
+ report("parseCommandLine",n,"ns_per_arg",elapsed(start)/((double)repetitions*numArgs));
+}
+
+// Saving all n parameters of the app to an ini file and loading it again. The schema grows from size to size.
+void benchmarkIni(int n)
+{
+ static int declared=0;
+ declareSchema("Ini",declared,n);
+ declared=n;
+ const std::string file="CmdLineParamsBenchmark.ini";
+ int repetitions=1+100000/n;
+ auto start=std::chrono::steady_clock::now();
+ for (int r=0;r<repetitions;r++)
+  ctkApp.save(file);
+ report("ini",n,"ns_per_param_save",elapsed(start)/((double)repetitions*n));
+ start=std::chrono::steady_clock::now();
+ for (int r=0;r<repetitions;r++)
+  ctkApp.load(file);
+ report("ini",n,"ns_per_param_load",elapsed(start)/((double)repetitions*n));
+ std::remove(file.c_str());
+}
+
+// Generating the xml description of all n parameters of the app, from scratch and from the cache. The schema grows from size to size.
+void benchmarkXML(int n)
+{
+ static int declared=0;
+ declareSchema("XML",declared,n);
+ declared=n;
+ std::vector<int> ids(n);
+ for (int i=0;i<n;i++) ids[i]=ctkApp.getParamId("XML",paramKey(i));
+ int repetitions=1+100000/n;
+ std::size_t length=0;
+ auto start=std::chrono::steady_clock::now();
+ for (int r=0;r<repetitions;r++)
+ {
+  ctkApp.schemaChanged();
+  for (int i=0;i<n;i++) ctkApp.schemaChanged(ids[i]);
+  length+=ctkApp.getXMLDescription().length();
+ }
+ report("xml",n,"ns_per_param",elapsed(start)/((double)repetitions*n));
+ start=std::chrono::steady_clock::now();
+ for (int r=0;r<repetitions;r++)
+  length+=ctkApp.getXMLDescription().length();
+ report("xml",n,"ns_per_param_cached",elapsed(start)/((double)repetitions*n));
+ if (length==0) std::cerr << "No xml description generated." << std::endl;
+}
+
+// Reads of n double parameters in a tight loop, through ctkParam<double> and through ctkParamRef<double>
+void benchmarkTypedReads(int n)
+{
+ std::string section="Typed Reads "+ctkCLI::toString(n);
+ std::vector<std::string> keys(n);
+ std::vector<ctkParamRef<double> > refs;
+ refs.reserve(n);
+ for (int i=0;i<n;i++)
+ {
+  keys[i]=paramKey(i);
+  ctkParam<double>(section,keys[i])=0.5*i;
+  refs.push_back(ctkParamRef<double>(section,keys[i]));
+ }
+ int repetitions=1+1000000/n;
+ double sum=0;
+ auto start=std::chrono::steady_clock::now();
+ for (int r=0;r<repetitions;r++)
+  for (int i=0;i<n;i++)
+   sum+=ctkParam<double>(section,keys[i]);
+ report("typedReads",n,"ns_per_read",elapsed(start)/((double)repetitions*n));
+ start=std::chrono::steady_clock::now();
+ for (int r=0;r<repetitions;r++)
+  for (int i=0;i<n;i++)
+   sum+=refs[i];
+ report("typedReads",n,"ns_per_read_ref",elapsed(start)/((double)repetitions*n));
+ if (sum<0) std::cerr << "Unexpected sum of values." << std::endl;
+}
+
+// Parsing a list of n coordinates through stringToVector and setting a double-vector parameter through a string
+void benchmarkVectorParsing(int n)
+{
+ std::vector<double> coordinates(n);
+ for (int i=0;i<n;i++) coordinates[i]=0.001*i-12.5;
+ std::string str=ctkCLI::toString(coordinates);
+ int repetitions=1+1000000/n;
+ std::vector<double> parsed;
+ auto start=std::chrono::steady_clock::now();
+ for (int r=0;r<repetitions;r++)
+  ctkCLI::stringToVector<double>(str,parsed,',');
+ report("vectorParsing",n,"ns_per_item_stringToVector",elapsed(start)/((double)repetitions*n));
+ ctkParam<std::vector<double> > points("Vector Parsing","Points");
+ start=std::chrono::steady_clock::now();
+ for (int r=0;r<repetitions;r++)
+  points.setString(str);
+ report("vectorParsing",n,"ns_per_item",elapsed(start)/((double)repetitions*n));
+ // in lazy mode, only the text is kept until the value is used
+ points.setLazy();
+ start=std::chrono::steady_clock::now();
+ for (int r=0;r<repetitions;r++)
+  points.setString(str);
+ report("vectorParsing",n,"ns_per_item_lazy",elapsed(start)/((double)repetitions*n));
+ points.setLazy(false);
+}
+
+// Reads of published parameters by n threads, while the main thread publishes new values all the time
+void benchmarkPublishedReads(int n)
+{
+ ctkParamRef<double> speed("Published Reads","Speed");
+ ctkParamRef<int> iterations("Published Reads","Iterations");
+ speed=1.0;
+ iterations=1;
+ ctkApp.publish();
+ const int reads=2000000;
+ std::atomic<int> running(n);
+ std::vector<double> sums(n,0.0);
+ std::vector<std::thread> readers;
+ auto start=std::chrono::steady_clock::now();
+ for (int t=0;t<n;t++)
+  readers.push_back(std::thread([&,t]() {
+   double sum=0;
+   for (int i=0;i<reads;i++)
+    sum+=speed.getPublished()*iterations.getPublished();
+   sums[t]=sum;
+   running--;
+  }));
+ int publications=0;
+ while (running>0)
+ {
+  speed=speed+1.0;
+  ctkApp.publish();
+  publications++;
+  std::this_thread::sleep_for(std::chrono::microseconds(100));
+ }
+ for (int t=0;t<n;t++)
+  readers[t].join();
+ double ns=elapsed(start);
+ // each getPublished is one read
+ report("publishedReads",n,"reads_per_second_per_thread",2.0*reads/(ns*1e-9));
+ report("publishedReads",n,"publications",publications);
+}
+
+// Run one group of benchmarks. Returns false for an unknown group.
+bool runGroup(const std::string& group)
+{
+ if (group=="declarationMemory")
+  benchmarkDeclarationMemory(1000);
+ else if (group=="declaration")
+  for (int i=0;i<numSchemaSizes;i++) benchmarkDeclaration(schemaSizes[i]);
+ else if (group=="parseCommandLine")
+  for (int i=0;i<numSchemaSizes;i++) benchmarkParseCommandLine(schemaSizes[i]);
+ else if (group=="ini")
+  for (int i=0;i<numSchemaSizes;i++) benchmarkIni(schemaSizes[i]);
+ else if (group=="xml")
+  for (int i=0;i<numSchemaSizes;i++) benchmarkXML(schemaSizes[i]);
+ else if (group=="typedReads")
+  for (int i=0;i<numSchemaSizes;i++) benchmarkTypedReads(schemaSizes[i]);
+ else if (group=="vectorParsing")
+ {
+  int lengths[]={10,1000,100000};
+  for (int i=0;i<3;i++) benchmarkVectorParsing(lengths[i]);
+ }
+ else if (group=="publishedReads")
+ {
+  int threads=(int)std::max(1u,std::thread::hardware_concurrency());
+  for (int n=1;n<=threads;n*=2) benchmarkPublishedReads(n);
+ }
+ else
+  return false;
+ return true;
+}
+
+int main(int argc, char ** argv)
+{
+ const char* groups[]={"declarationMemory","declaration","parseCommandLine","ini","xml","typedReads","vectorParsing","publishedReads"};
+ const int numGroups=sizeof(groups)/sizeof(groups[0]);
+ if (argc>1)
+ {
+  for (int i=1;i<argc;i++)
+   if (!runGroup(argv[i]))
+   {
+    std::cerr << "Unknown benchmark " << argv[i] << ". Available:";
+    for (int g=0;g<numGroups;g++) std::cerr << " " << groups[g];
+    std::cerr << std::endl;
+    return 1;
+   }
+  return 0;
+ }
+ // each group in a process of its own
+ int failed=0;
+ for (int g=0;g<numGroups;g++)
+  if (std::system(("\""+std::string(argv[0])+"\" "+groups[g]).c_str())!=0)
+  {
+   std::cerr << "Benchmark " << groups[g] << " failed." << std::endl;
+   failed++;
+  }
+ return failed ? 1 : 0;
+}
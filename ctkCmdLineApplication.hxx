@@ -22,18 +22,37 @@
 #ifndef __ctkCmdLineApplication_h
 #define __ctkCmdLineApplication_h
 
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
 #include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include <map>
 #include <typeinfo>
 
+#include "BinaryUtil.hxx"
+#include "FileUtil.hxx"
+#include "SocketUtil.hxx"
 #include "StringUtil.hxx"
+#include "ctkParamProfile.hxx"
+#include "ctkParamRegistry.hxx"
+#include "ctkParamSnapshot.hxx"
+#include "ctkParamStorage.hxx"
+#include "ctkParamValidation.hxx"
 
 #define CTK_INSTANTIATE_CMD_LINE_APP(TITEL, DESCRIPTION) \
+ CTK_PROFILE_INSTANTIATE_ALLOCATION_HOOKS \
  ctkCmdLineApplication ctkCmdLineApplication::mainInstance(TITEL,DESCRIPTION);
 
-/// Utility makro to access the application in a short expression
+/// Utility makro to access the application in a short expression: the default of the current thread (see ctkCmdLineApplicationScope)
 #define ctkApp ctkCmdLineApplication::Instance()
 
 //----------------------------------------------------------------------------
@@ -76,12 +95,43 @@ CTK_DEFINE_TYPE_NAME_STRING(std::vector<float>,"float-vector");
 CTK_DEFINE_TYPE_NAME_STRING(std::vector<double>,"double-vector");
 CTK_DEFINE_TYPE_NAME_STRING(std::vector<std::string>,"string-vector");
 
+/// Tags of the c++ types a parameter can hold, so that its exact type is known without RTTI (see ctkParamDataInterface::kind)
+enum ctkValueKind {
+ ctkValueOther=0,
+ ctkValueBool,
+ ctkValueInt,
+ ctkValueFloat,
+ ctkValueDouble,
+ ctkValueString,
+ ctkValueIntVector,
+ ctkValueFloatVector,
+ ctkValueDoubleVector,
+ ctkValueStringVector
+};
+
+/// The ctkValueKind of c++ type T. ctkValueOther for types other than those of getTypeName.
+template <typename T> constexpr ctkValueKind valueKind() { return ctkValueOther; }
+
+#define CTK_DEFINE_VALUE_KIND(TYPE,KIND)  template<> constexpr ctkValueKind valueKind<TYPE>() {return KIND;}
+CTK_DEFINE_VALUE_KIND(bool,ctkValueBool);
+CTK_DEFINE_VALUE_KIND(int,ctkValueInt);
+CTK_DEFINE_VALUE_KIND(float,ctkValueFloat);
+CTK_DEFINE_VALUE_KIND(double,ctkValueDouble);
+CTK_DEFINE_VALUE_KIND(std::string,ctkValueString);
+CTK_DEFINE_VALUE_KIND(std::vector<int>,ctkValueIntVector);
+CTK_DEFINE_VALUE_KIND(std::vector<float>,ctkValueFloatVector);
+CTK_DEFINE_VALUE_KIND(std::vector<double>,ctkValueDoubleVector);
+CTK_DEFINE_VALUE_KIND(std::vector<std::string>,ctkValueStringVector);
+
  /**
   * \ingroup Command Line Module
   *
   * Interface to ctkParamData classes
   *
-  * Essentially, this is a variant type.
+  * Essentially, this is a variant type: kind tags the c++ type of the value, which is
+  * held by the ctkParamValue of that type. Typed access (see valueOf, getValueAs and
+  * setValueAs) is a branch on kind. The virtual methods serve the string and binary
+  * representations only.
   *
   * Each parameter type supported by ctk implements its own ctkParamData-subclass.
   * For each defined parameter of a ctkCmdLineApplication, an instance of this class
@@ -96,16 +146,162 @@ CTK_DEFINE_TYPE_NAME_STRING(std::vector<std::string>,"string-vector");
  class ctkParamDataInterface
  {
  public:
+  ctkParamDataInterface(ctkValueKind k=ctkValueOther) : kind(k), lazy(false), dirty(false) {}
+  virtual ~ctkParamDataInterface() {}
   virtual std::string getType() const = 0;
-  virtual void setString(const std::string& new_value) = 0;
+  /// Set the value through a string. Returns false if the string could not be converted to the type of this parameter.
+  virtual bool setString(std::string_view new_value) = 0;
   virtual std::string getString() const = 0;
+  /// Type code of the binary representation of the value (see ctkCLI::binaryType)
+  virtual int getBinaryType() const = 0;
+  /// Append the binary representation of the value to out
+  virtual void writeBinary(std::string& out) const = 0;
+  /// Set the value from its binary representation. Returns false if the type code or size does not match this parameter.
+  virtual bool readBinary(int type, std::string_view in) = 0;
+  /// Take over the value of other, if it is of the same c++ type. Returns false otherwise (see ctkParamValue).
+  virtual bool moveValueFrom(ctkParamDataInterface& other) = 0;
+
+  /// Parameters live in the paramArena() rather than on the heap. It is shared by all instances of ctkCmdLineApplication.
+  static void* operator new(std::size_t n)
+  {
+   std::lock_guard<std::mutex> lock(paramArenaMutex());
+   return paramArena().allocate(n);
+  }
+  static void operator delete(void* p, std::size_t n)
+  {
+   std::lock_guard<std::mutex> lock(paramArenaMutex());
+   paramArena().deallocate(p,n);
+  }
 
   /// Additional information for the XML: such as "description", "label" etc.
-  std::map<std::string,std::string> tags;
+  ctkStringMap tags;
   /// Additional attributes to the xml node, such as "fileExtensions" or "coordinateSystem"
-  std::map<std::string,std::string> attribs;
+  ctkStringMap attribs;
   /// Additional constraints for this parameter. Used for double's mininum maximum and step
-  std::map<std::string,std::string> constraints; 
+  ctkStringMap constraints; 
+
+  /// The c++ type of the value. Each ctkParamValue<T> with a type of getTypeName sets valueKind<T>().
+  const ctkValueKind kind;
+
+  /// If set, setString only keeps the text. It is converted on first access to the value (see ctkParamValue::get),
+  /// once, even if several threads read the parameter concurrently.
+  bool lazy;
+
+  /// Set whenever the value is changed through set, setString, readBinary or moveValueFrom. Cleared by
+  /// ctkCmdLineApplication::save and setDefaults (see ctkCmdLineApplication::SaveChanged).
+  mutable bool dirty;
+ };
+
+ template <typename T> class ctkParamValue;
+
+ /// The storage of p, if p holds a value of c++ type T, else 0x0. A branch on p->kind for the types of getTypeName.
+ template <typename T> inline ctkParamValue<T>* valueOf(ctkParamDataInterface* p)
+ {
+  if constexpr (valueKind<T>()==ctkValueOther) return dynamic_cast<ctkParamValue<T>*>(p);
+  else return p && p->kind==valueKind<T>() ? static_cast<ctkParamValue<T>*>(p) : 0x0;
+ }
+ template <typename T> inline const ctkParamValue<T>* valueOf(const ctkParamDataInterface* p)
+ {
+  return valueOf<T>(const_cast<ctkParamDataInterface*>(p));
+ }
+
+ /**
+  * \ingroup Command Line Module
+  *
+  * Storage of a value of c++ type T, common to all ctkParamData classes of the same c++ type.
+  *
+  * Subclasses only define the type name for the XML. Thus, a ctkParamDataFile
+  * and a ctkParamData<std::string> can exchange their values without conversion.
+  **/
+ template <typename T>
+ class ctkParamValue : public ctkParamDataInterface
+ {
+  /// Text set in lazy mode, which has not been converted to value yet
+  mutable std::string text;
+  /// Set along with text. Readers which find it set convert under the lazyConversionMutex, the first one of them only.
+  mutable std::atomic<bool> pending;
+
+  /// Convert pending text. Safe to call from several threads which read the value: the first one converts, the others wait
+  /// for it. Otherwise, value is only ever modified through non-const objects, thus the const_cast is safe.
+  void convert() const
+  {
+   std::lock_guard<std::mutex> lock(lazyConversionMutex());
+   if (!pending.load(std::memory_order_relaxed))
+    return;
+   CTK_PROFILE_CONVERSION();
+   if (!stringTo(text,const_cast<T&>(value)))
+   {
+    ctkStringMap::const_iterator name=tags.find("name");
+    std::cerr << "Invalid value " << text << " for parameter " << (name!=tags.end() ? name->second : std::string()) << std::endl;
+   }
+   text.clear();
+   pending.store(false,std::memory_order_release);
+  }
+
+ public:
+  /// The value. Access through get() and set() for parameters in lazy mode.
+  T value;
+
+  ctkParamValue() : ctkParamDataInterface(valueKind<T>()), pending(false), value() {}
+
+  /// Access to the value. Converts text set in lazy mode first.
+  T& get() { if (pending.load(std::memory_order_acquire)) convert(); return value; }
+  const T& get() const { if (pending.load(std::memory_order_acquire)) convert(); return value; }
+  void set(const T& v) { pending=false; text.clear(); value=v; dirty=true; }
+  void set(T&& v) { pending=false; text.clear(); value=std::move(v); dirty=true; }
+
+  /// Set the value of this parameter though a string (eg. set a double parameter through string "123.456")
+  /// In lazy mode, the text is only checked when converted, thus this always succeeds.
+  virtual bool setString(std::string_view new_value)
+  {
+   if (!lazy)
+   {
+    CTK_PROFILE_CONVERSION();
+    if (!stringTo(new_value,get())) return false;
+    dirty=true;
+    return true;
+   }
+   text.assign(new_value.data(),new_value.length());
+   pending=true;
+   dirty=true;
+   return true;
+  }
+  /// Retreive the current value of any parameter as string. In lazy mode, text not yet converted is returned as is.
+  virtual std::string getString() const
+  {
+   if (pending.load(std::memory_order_acquire))
+   {
+    // another thread may be converting the text
+    std::lock_guard<std::mutex> lock(lazyConversionMutex());
+    if (pending.load(std::memory_order_relaxed)) return text;
+   }
+   CTK_PROFILE_CONVERSION();
+   return toString(value);
+  }
+  virtual int getBinaryType() const { return binaryType<T>(); }
+  virtual void writeBinary(std::string& out) const { binaryWrite(out,get()); }
+  virtual bool readBinary(int type, std::string_view in)
+  {
+   if (type!=binaryType<T>() || !binaryRead(in,value)) return false;
+   pending=false;
+   text.clear();
+   dirty=true;
+   return true;
+  }
+  virtual bool moveValueFrom(ctkParamDataInterface& other)
+  {
+   ctkParamValue<T>* same=valueOf<T>(&other);
+   if (same)
+   {
+    value=std::move(same->value);
+    // text not converted yet, stays so
+    text.swap(same->text);
+    pending=same->pending.load();
+    same->pending=false;
+    dirty=true;
+   }
+   return same!=0x0;
+  }
  };
 
  /**
@@ -120,18 +316,78 @@ CTK_DEFINE_TYPE_NAME_STRING(std::vector<std::string>,"string-vector");
   * also supported through std::vector<int|double> and std::vector<std::string>
   **/
  template <typename T>
- class ctkParamData : public ctkParamDataInterface
+ class ctkParamData : public ctkParamValue<T>
  {
  public:
-  T value;
   /// Returns the type of this parameter (eg. "integer", "file" or "string-vector" etc. )
   virtual std::string getType() const { return getTypeName<T>(); }
-  /// Set the value of this parameter though a string (eg. set a double parameter through string "123.456")
-  virtual void setString(const std::string& new_value) { value=stringTo<T>(new_value); }
-  /// Retreive the current value of any parameter as string
-  virtual std::string getString() const { return toString(value); }
  };
 
+ /// Convert a number without strings. Fails like stringTo would: if out of range of Out, or if the fractional part would be lost for integers.
+ template <typename Out, typename In> inline bool convertNumber(In in, Out& out)
+ {
+  // (int, float and double are all exactly representable as double)
+  double d=(double)in;
+  if (!(d>=(double)std::numeric_limits<Out>::lowest() && d<=(double)std::numeric_limits<Out>::max())) return false;
+  Out v=static_cast<Out>(in);
+  if (std::numeric_limits<Out>::is_integer && (double)v!=d) return false;
+  out=v;
+  return true;
+ }
+
+ /// Get the value of int, float and double parameters as another of these types. Returns false for other kinds or if conversion fails.
+ template <typename T> inline bool getNumber(const ctkParamDataInterface* p, T& out)
+ {
+  switch (p->kind)
+  {
+   case ctkValueInt:    return convertNumber(valueOf<int>(p)->get(),out);
+   case ctkValueFloat:  return convertNumber(valueOf<float>(p)->get(),out);
+   case ctkValueDouble: return convertNumber(valueOf<double>(p)->get(),out);
+   default:             return false;
+  }
+ }
+
+ /// Set the value of int, float and double parameters from another of these types. Returns false for other kinds or if conversion fails.
+ template <typename T> inline bool setNumber(ctkParamDataInterface* p, T in)
+ {
+  int i; float f; double d;
+  switch (p->kind)
+  {
+   case ctkValueInt:    if (!convertNumber(in,i)) return false; valueOf<int>(p)->set(i); return true;
+   case ctkValueFloat:  if (!convertNumber(in,f)) return false; valueOf<float>(p)->set(f); return true;
+   case ctkValueDouble: if (!convertNumber(in,d)) return false; valueOf<double>(p)->set(d); return true;
+   default:             return false;
+  }
+ }
+
+ /// The value of parameter p as c++ type T. The same type is returned as is, int, float and double convert
+ /// into each other directly. Anything else converts through strings.
+ template <typename T> inline T getValueAs(const ctkParamDataInterface* p)
+ {
+  const ctkParamValue<T>* same=valueOf<T>(p);
+  if (same) return same->get();
+  if constexpr (valueKind<T>()==ctkValueInt || valueKind<T>()==ctkValueFloat || valueKind<T>()==ctkValueDouble)
+  {
+   T value;
+   if (getNumber(p,value)) return value;
+  }
+  return stringTo<T>(p->getString());
+ }
+
+ /// Set the value of parameter p from c++ type T (see getValueAs). Returns false if the value could not be converted.
+ template <typename T> inline bool setValueAs(ctkParamDataInterface* p, const T& value)
+ {
+  ctkParamValue<T>* same=valueOf<T>(p);
+  if (same)
+  {
+   same->set(value);
+   return true;
+  }
+  if constexpr (valueKind<T>()==ctkValueInt || valueKind<T>()==ctkValueFloat || valueKind<T>()==ctkValueDouble)
+   if (setNumber(p,value)) return true;
+  return p->setString(toString(value));
+ }
+
 } // namespace ctkCLI
 
 /**
@@ -152,66 +408,435 @@ CTK_DEFINE_TYPE_NAME_STRING(std::vector<std::string>,"string-vector");
  * ctkParamImage, ctkParamDouble (allows setting min/max and step for a slider) and others.
  *
  * You can also store and retreive the values of all parameters via ini-Files load(...) and save(...)
+ *
+ * Threads: parameters are declared, parsed and changed by one control thread.
+ * Other threads read immutable snapshots of all values, which the control thread
+ * makes available through publish() (see published() and ctkParamRef::getPublished()).
+ *
+ * Instances: besides the main instance (see CTK_INSTANTIATE_CMD_LINE_APP), further
+ * independent instances may be created, eg. to run several configurations of a
+ * pipeline concurrently in one process. ctkParam and the other proxies bind to ctkApp,
+ * the default of the current thread (see ctkCmdLineApplicationScope), or to an
+ * instance passed explicitly. Each instance is used by one thread at a time.
  **/
 class ctkCmdLineApplication
 {
  // a few const iterator typedefs
- typedef std::map<std::string,std::string>::const_iterator MapIteratorStrStr;
+ typedef ctkCLI::ctkStringMap::const_iterator MapIteratorStrStr;
  typedef std::map<std::string,ctkCLI::ctkParamDataInterface*>::const_iterator MapIteratorStrParam;
- typedef std::map<std::string,std::map<std::string,ctkCLI::ctkParamDataInterface*> >::const_iterator MapIteratorStrStrParam;
+ typedef std::vector<int>::const_iterator IteratorId;
+
+private:
+ /// Holds all parameters referenced by section and key and the command line flags. Also includes "0", "1" etc. for indexed parameters
+ ctkCLI::ctkParamRegistry registry;
+
+ /// Cached parts of the xml description: the header with the tags of the app and the parts before and after the default value of each parameter (by id)
+ mutable std::string xmlHeader;
+ mutable std::vector<std::string> xmlParts;
+ mutable std::vector<bool> xmlValid;
+ /// Replaces the xml description, if not empty (see setXMLDescription)
+ std::string xmlPrecomputed;
+
+ /// Snapshots of the values for readers in other threads (see publish)
+ ctkCLI::ctkSnapshotDomain snapshots;
+ std::uint64_t generation;
+
+ /// The values taken as defaults by setDefaults or 0x0
+ std::unique_ptr<ctkCLI::ctkParamSnapshot> defaultValues;
+
+ /// The file attached to through attachShared and the generation last attached
+ std::string sharedFile;
+ std::uint64_t sharedGeneration;
+
+ /// The values of all parameters (or of those with channel "input") in the binary parameter file format
+ std::string getBinary(std::uint64_t gen=0, bool inputsOnly=false) const;
+
+ /// Set values from the contents of a binary parameter file. source is used in messages.
+ bool setBinary(std::string_view contents, const std::string& source);
+
+ /// A snapshot of the current values of all parameters
+ ctkCLI::ctkParamSnapshot* takeSnapshot(std::uint64_t gen) const;
+
+ /// The normalized names of all parameters by id (empty for ids without parameter)
+ std::vector<std::string_view> getNames() const;
+
+ /// The generation in the header of a binary parameter file or 0, if there is none
+ static std::uint64_t readGeneration(const std::string& binFile);
+
+public:
+ /// Called for each parameter set of a batch with its number and values (see runBatch)
+ typedef std::function<void(int set, const ctkCLI::ctkParamSnapshot& values)> BatchCallback;
+
+private:
+ /// Saves the profile of the main instance to the file given by --ctk-profile
+ static void saveProfileAtExit();
+
+#ifdef CTK_CLI_PROFILING
+ /// Measurements of this instance (see getProfileJSON)
+ mutable ctkCLI::ctkProfile profiling;
+
+public:
+ /// Measurements of this instance, for CTK_PROFILE_PHASE and CTK_PROFILE_ACCESS
+ ctkCLI::ctkProfile& getProfile() const { return profiling; }
 
 private:
- /// Holds values of all parameters referenced by section and key
- std::map<std::string, std::map<std::string, ctkCLI::ctkParamDataInterface * > > param;
- /// Holds section/key pairs for specific command line flags. Also includes "0", "1" etc. for indexed parameters
- std::map<std::string,std::pair<std::string,std::string> > commandLineFlags;
+#endif
+
+ /// Answer requests from stream until its end or a request "quit" (see serve). count is the number of requests so far.
+ bool serveRequests(ctkCLI::ctkRequestStream& stream, const BatchCallback& callback, const std::string& defaults, int& count);
+
+ /// Batch mode through the command line (see setBatchCallback)
+ BatchCallback batchCallback;
+ int batchThreads;
+ bool batchRan;
+
+ /// Cached help texts, plain and column-aligned (see getSynopsis)
+ mutable std::string synopsis[2];
+ /// Whether --help prints the column-aligned help text
+ bool alignedHelp;
+ /// Numeric vectors larger than this in binary go to sidecar files (see setSidecarThreshold)
+ std::size_t sidecarBytes;
+
+ /// Compiled constraints of the parameters which have any (see validate)
+ mutable std::vector<ctkCLI::ctkParamCheck> checks;
+ mutable bool checksValid;
+ /// Set during parseCommandLine, which validates once all arguments are applied
+ bool parsing;
+
+public:
+ /// Sources of values, in increasing priority (see resolve)
+ enum Layer { LayerDefault, LayerSystem, LayerUser, LayerEnvironment, LayerCommandLine };
+
+private:
+ /// A value collected by resolve, referenced in its source, with its line number in ini-files
+ struct LayerValue
+ {
+  std::string_view value;
+  Layer layer;
+  int line;
+ };
+ /// The layer of each value in the last resolve (by id)
+ std::vector<Layer> layers;
+
+ /// Parse values from a string in ini-file format. If found is not 0x0, values are only collected into found by id, for layer.
+ bool parseIni(std::string_view ini, const std::string& source, std::vector<LayerValue>* found, Layer layer);
+
+ /// Set parameter id from a value in an ini-file (or the environment if source is empty), or from the sidecar file
+ /// it refers to (see setSidecarThreshold)
+ bool assign(int id, std::string_view value, const std::string& source);
+
+ /// Parse the contents of an ini-file and validate them, unless parsing (see load)
+ bool load(const ctkCLI::ctkMappedFile& file, const std::string& iniFile);
+
+public:
+ /// Called with the ids of the changed parameters an observer depends on (see observe)
+ typedef std::function<void(const std::vector<int>& changed)> ChangeCallback;
+
+private:
+ /// Depends on a list of parameters by id or on section/key (all keys of section, if key is empty)
+ struct Observer
+ {
+  int handle;
+  std::vector<int> ids;
+  std::string section, key;
+  ChangeCallback callback;
+ };
+ std::vector<Observer> observers;
+ int nextObserver;
+ /// Nesting of beginChanges/endChanges
+ int changeDepth;
+ /// Parameters which may have changed since the last notification, with their values before
+ std::vector<int> pendingIds;
+ std::vector<std::string> pendingValues;
+ std::vector<bool> pending;
+
+ /// The value of a parameter for comparison: binary, or text in lazy mode, so that it is not converted
+ static void currentValue(const ctkCLI::ctkParamDataInterface& p, std::string& out);
+
+ /// Call the observers of the pending changes (see notifyChanges)
+ void dispatchChanges();
+
+ /// Describe parameter id in xml, except for its default value, which goes between head and tail
+ void describeParam(int id, std::string& head, std::string& tail) const;
 
   /**
-  * This is the singleton instance of ctkCmdLineApplication.
+  * This is the main instance of ctkCmdLineApplication.
   * The user needs to define this static variable himself through the makro CTK_INSTANTIATE_CMD_LINE_APP
   **/
  static ctkCmdLineApplication mainInstance;
- /// Constructor requires and name and description of app
+
+ /// The default instance of the current thread, if not the main instance (see setThreadInstance)
+ static ctkCmdLineApplication*& threadInstance()
+ {
+  static thread_local ctkCmdLineApplication* app=0x0;
+  return app;
+ }
+
+ ctkCmdLineApplication(const ctkCmdLineApplication&);
+ ctkCmdLineApplication& operator=(const ctkCmdLineApplication&);
+
+public:
+ /// Constructor requires and name and description of app. Instances other than the main instance hold
+ /// parameters of their own, which are independent of all other instances.
  ctkCmdLineApplication(const std::string& titel, const std::string& description)
+  : generation(0), sharedGeneration(0), batchThreads(1), batchRan(false), alignedHelp(false), sidecarBytes(0), checksValid(false), parsing(false), nextObserver(0), changeDepth(0)
  {
   tags["description"]=description;
   tags["title"]=titel;
  }
 
-public: 
- /// Access to the singleton instance
- static ctkCmdLineApplication& Instance() { return mainInstance; }
+ ~ctkCmdLineApplication();
+
+ /// Access to the default instance of the current thread: the main instance, unless another one has been set (see setThreadInstance)
+ static ctkCmdLineApplication& Instance()
+ {
+  ctkCmdLineApplication* app=threadInstance();
+  return app ? *app : mainInstance;
+ }
+
+ /// Make app the default instance of the current thread (0x0 for the main instance). Returns the previous one.
+ /// Prefer ctkCmdLineApplicationScope, which restores the previous one.
+ static ctkCmdLineApplication* setThreadInstance(ctkCmdLineApplication* app)
+ {
+  ctkCmdLineApplication* previous=threadInstance();
+  threadInstance()=app;
+  return previous;
+ }
 
  /// Access a parameter by section/key pair. Returns null if the parameter is unknown.
- ctkCLI::ctkParamDataInterface* getParam(const std::string& section, const std::string& key);
+ ctkCLI::ctkParamDataInterface* getParam(std::string_view section, std::string_view key);
+
+ /// Id of a parameter by section/key pair. Stays valid if setParam replaces the parameter. Returns -1 if the parameter is unknown.
+ int getParamId(std::string_view section, std::string_view key) const { return registry.find(section,key); }
+
+ /// Id of a section/key pair, which is added without a parameter, if it is unknown (see setParam(id,p))
+ int addParamId(std::string_view section, std::string_view key) { return registry.insert(section,key); }
+
+ /// Access a parameter by its id (see getParamId)
+ ctkCLI::ctkParamDataInterface* getParam(int id) const { return registry[id].data; }
+
+ /// Changes whenever the parameter of an id is replaced through setParam, even if the new one has the same address
+ unsigned int getParamGeneration(int id) const { return registry[id].generation; }
+
+ /// The section, key and normalized name of a parameter by its id (held by the app, eg. instead of copies in ctkParam)
+ const std::string& getParamSection(int id) const { return registry.getSection(id); }
+ std::string_view getParamKey(int id) const { return registry[id].key; }
+ std::string_view getParamName(int id) const { return registry[id].name; }
 
  /// Add or Replace a parameter by section/key pair. Note that ownership is transferred.
- void setParam(const std::string& section, const std::string& key, ctkCLI::ctkParamDataInterface*);
+ void setParam(std::string_view section, std::string_view key, ctkCLI::ctkParamDataInterface*);
+
+ /// Add or Replace a parameter by its id (see addParamId). Note that ownership is transferred.
+ void setParam(int id, ctkCLI::ctkParamDataInterface*);
+
+ /// Same as setParam(section,key,p) for a precomputed normalized name and its hash (see ctkCLI::ctkStaticParam). Returns the id of the parameter.
+ int setParam(std::string_view section, std::string_view key, std::string_view name, std::size_t hash, ctkCLI::ctkParamDataInterface*);
+
+ /// Declare parameters described at compile time at once (see ctkParamSchema.hxx)
+ template <typename... Params> void declare(const Params&... params)
+ {
+  registry.reserve(registry.size()+(int)sizeof...(params));
+  (params.declareIn(*this),...);
+ }
 
  /// Associate a command line flag with a parameter through its section/key pair
  void setFlag(const std::string& flag,const std::string& section,const std::string& key);
 
- /// parse command line argumants and set parameters accordingly. Unhandled parameters are left in argv.
- void parseCommandLine(int *argc, char ** argv);
+ /// Associate a command line flag with a parameter by its id
+ void setFlag(std::string_view flag, int id);
+
+ /// parse command line argumants and set parameters accordingly. Unhandled parameters are left in argv and argc is updated.
+ /// Returns false if any value was invalid or violates a constraint (see validate), so that main can reject the input. Constraints
+ /// are not checked if --xml or --help was given, which only describe the app.
+ bool parseCommandLine(int *argc, char ** argv);
 
  /// Load values of parameters from a string in ini-file format ie. <br> [Section] <br> Key = Value <br> Key2 = Another Value
- void parse(const std::string& iniStr);
+ /// Unknown parameters and invalid values are reported with their line number (and source, eg. the file name). Returns false if there were any.
+ bool parse(std::string_view iniStr, const std::string& source="");
 
- /// Load values of parameters from an ini-File
+ /// Load values of parameters from an ini-File and validate them. Returns false if the file could not be read.
  bool load(const std::string& iniFile);
 
- /// Save values of parameters to an ini-File
- void save(const std::string& iniFile) const;
+ /// Load several ini-files in order, with the same result as load for each. The files are read concurrently and each is parsed
+ /// as soon as it and its predecessors have arrived. parseCommandLine does this for repeated --ctk-load-ini <file>.
+ /// Validates once. Files which could not be read are reported and skipped. Returns false if there were any.
+ bool load(const std::vector<std::string>& iniFiles);
+
+ /// Resolve the values of all parameters from layered sources, in increasing priority: the defaults of their declaration,
+ /// a system and a user ini-file (either may be empty or missing), environment variables (see environmentName) and the
+ /// command line, which is then handled as by parseCommandLine. The sources are collected first, so that each parameter is
+ /// converted once from the layer with the highest priority which has a value (see getLayer), and validated once.
+ /// Boolean flags on the command line toggle the value of the lower layers. Returns false if any value was invalid (see parseCommandLine).
+ bool resolve(int *argc, char ** argv, const std::string& systemIni, const std::string& userIni);
+
+ /// The layer the value of parameter id came from in the last resolve
+ Layer getLayer(int id) const { return id>=0 && id<(int)layers.size() ? layers[id] : LayerDefault; }
+
+ /// Name of a layer, eg. for reporting where values came from
+ static const char* layerName(Layer layer)
+ {
+  static const char* names[]={"default","system","user","environment","command line"};
+  return names[layer];
+ }
+
+ /// The environment variable resolve reads for section/key: CTK_SECTION_KEY in upper case, other characters than
+ /// letters and digits replaced by '_'
+ static std::string environmentName(std::string_view section, std::string_view key);
+
+ /// Call callback after parameter section/key has changed (or any parameter of section, if key is empty).
+ /// Changes are coalesced: parse, load, loadBinary and parseCommandLine notify once, with all parameters which changed.
+ /// Values which are set, but end up the same, are not reported. Returns a handle for unobserve.
+ int observe(const std::string& section, const std::string& key, const ChangeCallback& callback);
+
+ /// Call callback after any of the parameters by id has changed, eg. for a stage of a pipeline which only depends on these.
+ int observe(const std::vector<int>& ids, const ChangeCallback& callback);
+
+ /// Remove an observer
+ void unobserve(int observer);
+
+ /// Collect changes until the matching endChanges, then notify observers once. May be nested.
+ void beginChanges() { changeDepth++; }
+ void endChanges() { if (--changeDepth==0) notifyChanges(); }
+
+ /// Tell the app that parameter id is about to be changed (see ctkParam::setValue). Cheap without observers.
+ void willChange(int id)
+ {
+  if (observers.empty() || id<0) return;
+  if (id>=(int)pending.size()) pending.resize(registry.size(),false);
+  if (pending[id] || !registry[id].data) return;
+  pending[id]=true;
+  pendingIds.push_back(id);
+  pendingValues.push_back(std::string());
+  currentValue(*registry[id].data,pendingValues.back());
+ }
+
+ /// Notify observers of all changes since the last notification, unless within beginChanges/endChanges
+ void notifyChanges() { if (changeDepth==0 && !pendingIds.empty()) dispatchChanges(); }
+
+ /// Check the values of all parameters against their constraints: ranges (ctkParamDouble::setRange), enumerations,
+ /// file extensions of files, images and geometries, and existence of directories. Violations are reported to std::cerr.
+ /// The constraints are compiled once per schema. Filesystem checks run concurrently on up to threads threads.
+ /// Returns false if any constraint is violated. Happens after parseCommandLine (unless only describing the app) and load.
+ bool validate(int threads=8) const;
+
+ /// Which parameters save writes
+ enum SaveMode {
+  /// All parameters
+  SaveAll,
+  /// Only those whose value differs from their default (see setDefaults). --ctk-save-ini-delta <file> does this.
+  SaveNonDefault,
+  /// Only those changed since the last save or setDefaults (see ctkParamDataInterface::dirty)
+  SaveChanged
+ };
+
+ /// Save values of parameters to an ini-File. The file is written at once from a buffer.
+ void save(const std::string& iniFile, SaveMode mode=SaveAll) const;
+
+ /// Let save write the values of integer, float and double vectors (eg. ctkParamPoint) larger than bytes in binary to
+ /// sidecar files <iniFile>.<name>.bin in the binary parameter file format, which the ini-file refers to as "Key = @<file>".
+ /// load and parse read such references for numeric vectors, relative to the ini-file. 0 (the default) writes all values inline.
+ void setSidecarThreshold(std::size_t bytes) { sidecarBytes=bytes; }
+
+ /// Take the current values as the defaults for save(..., SaveNonDefault). Marks all parameters as unchanged.
+ /// Happens when parseCommandLine is first called, so that the values assigned in code before are the defaults.
+ void setDefaults();
+
+ /// Load values of parameters from a binary file (see BinaryUtil.hxx). Values are referenced by the normalized name of their parameter.
+ bool loadBinary(const std::string& binFile);
+
+ /// Save values of parameters to a binary file. Unlike ini-Files, values are stored without conversion to text.
+ bool saveBinary(const std::string& binFile) const;
+
+ /// Stable hash of the values of all parameters, or only of those with channel "input" (see ctkParam::setChannel), eg. as
+ /// a key for caching results. It is computed over names, types and binary values (see BinaryUtil.hxx), not their text,
+ /// and does not depend on the order of declaration. It is the same across runs on platforms of the same byte order.
+ std::uint64_t getHash(bool inputsOnly=false) const;
+
+ /// Names of the parameters whose values differ from those in the contents of a binary parameter file or snapshot
+ /// (see loadBinary and ctkParamSnapshot::data), including parameters only in one of them.
+ std::vector<std::string> diff(std::string_view binary, bool inputsOnly=false) const;
+
+ /// Write the current values to a binary file for other processes, eg. in /dev/shm (see attachShared). The file is written aside
+ /// and then replaces binFile, so that attached processes never see a partial file. Its generation is one more than that of the
+ /// file it replaces. Returns the generation written or 0 on failure. --ctk-publish-shared <file> does this.
+ std::uint64_t publishShared(const std::string& binFile);
+
+ /// Map a binary file written by publishShared and publish it as the current snapshot (see published and ctkParamRef::getPublished).
+ /// Values are read in place from the mapping, which the processes share, without parsing or copies. Use loadBinary to set
+ /// the parameters themselves instead. Returns false, if the file could not be read. --ctk-attach-shared <file> does this.
+ bool attachShared(const std::string& binFile);
+
+ /// Hot reload: attach the file of attachShared again, if it has been replaced by another generation since.
+ /// Only reads the header of the file otherwise. Returns true, if another generation was attached.
+ bool refreshShared();
+
+ /// Evaluate many parameter sets in one process, eg. for parameter sweeps. Sets are in ini-file format, separated by lines "---".
+ /// Each set is applied on top of the current values, which are restored afterwards. The callback is called for each set
+ /// with its values. With threads>1, the callback is called concurrently on a pool of threads and must only use the given
+ /// values. Else, it is called in this thread and the parameters also hold the values of the set.
+ /// Sets with unknown parameters or invalid values are reported and skipped. Returns the number of sets evaluated.
+ int runBatch(std::string_view sets, const BatchCallback& callback, int threads=1, const std::string& source="");
+
+ /// Same as runBatch(...) for the contents of a file. Returns -1 if the file could not be read.
+ int runBatchFile(const std::string& batchFile, const BatchCallback& callback, int threads=1);
+
+ /// Stay resident and evaluate parameter sets as they arrive from stdin (where is "-") or a Unix socket at path where.
+ /// Each request is a set in ini-file format terminated by a line "---" or the contents of a binary parameter file.
+ /// Like runBatch with one thread, the set is applied on top of the current values and passed to the callback.
+ /// Each request is answered by a line "ok <n>" or "error <n>" (after any output of the callback to std::cout for stdin).
+ /// The request "quit" ends serving, so does the end of stdin. Returns the number of requests or -1 if the socket could not be created.
+ int serve(const std::string& where, const BatchCallback& callback);
+
+ /// Enables batch mode through the command line: --ctk-batch <file> runs all sets in the file (see runBatch) during parseCommandLine.
+ /// --ctk-batch-threads <n> overrides the number of threads. --ctk-serve <socket|-> serves requests (see serve).
+ void setBatchCallback(const BatchCallback& callback, int threads=1) { batchCallback=callback; batchThreads=threads; schemaChanged(); }
+
+ /// True, if parseCommandLine ran a batch or served requests. Then, main should usually return, since all sets have been evaluated.
+ bool ranBatch() const { return batchRan; }
+
+ /// Publish the current values of all parameters as an immutable snapshot for readers in other threads (see published).
+ /// Replaces the previous snapshot atomically. Returns the generation of the new snapshot.
+ /// Must not be called while the calling thread holds a guard returned by published().
+ std::uint64_t publish();
+
+ /// Access the most recently published snapshot without locking. Empty, if nothing was published yet.
+ /// Hold the guard only briefly: snapshots it keeps alive are not deleted.
+ ctkCLI::ctkSnapshotGuard published() { return ctkCLI::ctkSnapshotGuard(snapshots); }
 
  /// Returns a slicer-compatible xml description of the command line parameters of this app for use as a plugin to ctk-hosts.
+ /// The description is cached, only parameters changed through setParam, setFlag or schemaChanged are described anew.
  std::string getXMLDescription() const;
 
- /// Returns a somewhat nicely formatted man page as string
- std::string getSynopsis();
+ /// Write the xml description to a stream, eg. std::cout for --xml
+ void writeXMLDescription(std::ostream& out) const;
+
+ /// Write the xml description to a file, eg. a sidecar file next to the executable or a source file to be compiled in.
+ bool saveXMLDescription(const std::string& xmlFile) const;
+
+ /// Use a precomputed xml description instead of generating one (eg. embedded at build time from a file written by --ctk-save-xml).
+ void setXMLDescription(const std::string& xml) { xmlPrecomputed=xml; }
+
+ /// Tell the app that tags, attribs or constraints of parameter id (or of the app itself for -1) have changed. Invalidates cached descriptions.
+ void schemaChanged(int id=-1);
+
+ /// Measurements of the parameter handling of this instance as JSON: phases with wall time, allocations and bytes, and accesses
+ /// by parameter, with the allocations, lookups and conversions of the process. Requires CTK_CLI_PROFILING (see ctkParamProfile.hxx),
+ /// else returns an empty object.
+ std::string getProfileJSON() const;
+
+ /// Write getProfileJSON() to a file. --ctk-profile <file> does this at exit.
+ bool saveProfile(const std::string& jsonFile) const;
+
+ /// Returns a somewhat nicely formatted man page as string. If aligned, options and their descriptions are printed in two columns.
+ /// The text is cached like the xml description (see schemaChanged).
+ std::string getSynopsis(bool aligned=false) const;
+
+ /// Print the column-aligned help text for --help (eg. for tools with very many options)
+ void setAlignedHelp(bool aligned=true) { alignedHelp=aligned; }
 
  // Makro to define properties for slicer xml tags
  #define CTK_APP_DEFINE_TAG(XMLTAG,FUNCNAME) \
-  void set##FUNCNAME(const std::string& str) { tags[XMLTAG]=str; } \
+  void set##FUNCNAME(const std::string& str) { tags[XMLTAG]=str; schemaChanged(); } \
   std::string get##FUNCNAME() { return tags[XMLTAG]; }
 
  /// Additional tags in the XML file
@@ -227,67 +852,172 @@ public:
 
 };
 
+/**
+ * \ingroup Command Line Module
+ *
+ * Makes an instance the default of the current thread (see ctkApp) for the lifetime
+ * of the scope, eg. in each of several threads running their own configuration.
+ *
+ * Syntax example:<br>
+ *   ctkCmdLineApplication app("Pipeline","One configuration");<br>
+ *   ctkCmdLineApplicationScope scope(app);<br>
+ *   ctkParam<int>("Algorithm","Max Iteration")=10; // a parameter of app<br>
+ **/
+class ctkCmdLineApplicationScope
+{
+ ctkCmdLineApplication* previous;
+
+ ctkCmdLineApplicationScope(const ctkCmdLineApplicationScope&);
+ ctkCmdLineApplicationScope& operator=(const ctkCmdLineApplicationScope&);
+
+public:
+ explicit ctkCmdLineApplicationScope(ctkCmdLineApplication& app) : previous(ctkCmdLineApplication::setThreadInstance(&app)) {}
+ ~ctkCmdLineApplicationScope() { ctkCmdLineApplication::setThreadInstance(previous); }
+};
+
 //----------------------------------------------------------------------------
 //--- DEFINITIONS
 //----------------------------------------------------------------------------
 
+ctkCmdLineApplication::~ctkCmdLineApplication()
+{
+#ifdef CTK_CLI_PROFILING
+ if (this!=&mainInstance && !profiling.outputFile.empty() && !saveProfile(profiling.outputFile))
+  std::cerr << "Failed to write " << profiling.outputFile << std::endl;
+#endif
+ for (int id=0;id<registry.size();id++)
+  delete registry[id].data;
+}
+
+//----------------------------------------------------------------------------
 
 void ctkCmdLineApplication::setFlag(const std::string& flag,const std::string& section,const std::string& key)
 {
- commandLineFlags[flag]=std::pair<std::string,std::string>(section,key);
+ setFlag(flag,registry.insert(section,key));
 }
 
 //----------------------------------------------------------------------------
 
-ctkCLI::ctkParamDataInterface* ctkCmdLineApplication::getParam(const std::string& section, const std::string& key)
+void ctkCmdLineApplication::setFlag(std::string_view flag, int id)
 {
- if (param.find(section)!=param.end() && param[section].find(key) != param[section].end())
-  return param[section][key];
- else
-  return 0x0;
+ CTK_PROFILE_PHASE(profiling,"declare");
+ registry.setFlag(flag,id);
+ schemaChanged(id);
+}
+
+//----------------------------------------------------------------------------
+
+ctkCLI::ctkParamDataInterface* ctkCmdLineApplication::getParam(std::string_view section, std::string_view key)
+{
+ int id=registry.find(section,key);
+ return id<0 ? 0x0 : registry[id].data;
+}
+
+//----------------------------------------------------------------------------
+
+void ctkCmdLineApplication::setParam(std::string_view section, std::string_view key, ctkCLI::ctkParamDataInterface *p)
+{
+ setParam(section,key,ctkCLI::normName(section,key),ctkCLI::hashNormName(section,key),p);
+}
+
+//----------------------------------------------------------------------------
+
+int ctkCmdLineApplication::setParam(std::string_view section, std::string_view key, std::string_view name, std::size_t hash, ctkCLI::ctkParamDataInterface *p)
+{
+ int id=registry.insert(section,key,name,hash);
+ setParam(id,p);
+ return id;
 }
 
 //----------------------------------------------------------------------------
 
-void ctkCmdLineApplication::setParam(const std::string& section, const std::string& key, ctkCLI::ctkParamDataInterface *p)
+void ctkCmdLineApplication::setParam(int id, ctkCLI::ctkParamDataInterface *p)
 {
- // Add parameter. If another one by the same section/key already exists, preserve value.
- std::string value;
- if (param[section].find(key) != param[section].end())
+ CTK_PROFILE_PHASE(profiling,"declare");
+ // If another parameter by the same id already exists, preserve value.
+ schemaChanged(id);
+ ctkCLI::ctkParamDataInterface *old=registry.setData(id,p);
+ if (old)
  {
   // if a different parameter exists already, we have to delete it.
-  value=param[section][key]->getString();
-  delete param[section][key];
+  // Values of the same c++ type are moved, others are converted through a string.
+  p->lazy=old->lazy;
+  if (!p->moveValueFrom(*old))
+  {
+   std::string value=old->getString();
+   if (!value.empty())
+    p->setString(value);
+  }
+  delete old;
  }
- param[section][key]=p;
- if (!value.empty())
-  p->setString(value);
 }
 
 //----------------------------------------------------------------------------
 
-void ctkCmdLineApplication::parseCommandLine(int *argc, char ** argv)
+bool ctkCmdLineApplication::parseCommandLine(int *argc, char ** argv)
 {
+ CTK_PROFILE_PHASE(profiling,"parseCommandLine");
+ if (!defaultValues)
+  setDefaults();
+ parsing=true;
+ bool valid=true;
+ // --xml and --help only describe the app, eg. to a host which enumerates plugins. Then, values are not validated.
+ bool describing=false;
+ beginChanges();
  int index=0; // current index arguments not marked by '-' and "--"
- for (int i=0;i<*argc;)
+ std::string batchFile, serveAt;
+ // several ini-files are read concurrently up front, but still applied in the order of the arguments. Only those before
+ // the first argument which writes files are, since it may write one of them (possibly by another spelling of its path).
+ // The values of all options are skipped as below, so that a value which reads like an option is not taken for one.
+ std::vector<std::string> iniFiles;
+ std::vector<int> iniArgs;
+ for (int i=1;i+1<*argc;i++)
+ {
+  std::string_view arg(argv[i]);
+  if (arg.substr(0,11)=="--ctk-save-" || arg=="--ctk-publish-shared" || arg=="--ctk-serve")
+   break;
+  if (arg=="--ctk-load-ini")
+  {
+   iniArgs.push_back(++i);
+   iniFiles.push_back(argv[i]);
+   continue;
+  }
+  if (arg.empty() || arg[0]!='-' || arg=="--xml" || arg=="--help" || arg=="-h")
+   continue;
+  // all options of ctkCmdLineApplication but these take a value, so do flags of parameters other than booleans
+  int id=-1;
+  if (arg.substr(0,6)=="--ctk-")
+   i++;
+  else if ((id=registry.findFlag(arg))>=0 && registry[id].data && !ctkCLI::valueOf<bool>(registry[id].data))
+   i++;
+ }
+ std::unique_ptr<ctkCLI::ctkFilePrefetch> prefetched;
+ std::size_t nextIni=0;
+ if (iniFiles.size()>1)
+  prefetched.reset(new ctkCLI::ctkFilePrefetch(iniFiles));
+ // argv[0] is the executable itself
+ for (int i=1;i<*argc;i++)
  {
-  std::string cmd=argv[i];
+  std::string_view cmd(argv[i]);
   // --xml prints the xml description. Overrides anything else.
   if (cmd=="--xml")
   {
-   std::cout << getXMLDescription();
-   argv[i++]=0x0; // mark as handled
+   writeXMLDescription(std::cout);
+   describing=true;
+   argv[i]=0x0; // mark as handled
    continue;
   }
   // help text
   if (cmd=="--help" || cmd=="-h")
   {
-   std::cout << getSynopsis();
-   argv[i++]=0x0; // mark as handled
+   std::cout << getSynopsis(alignedHelp);
+   describing=true;
+   argv[i]=0x0; // mark as handled
    continue;
   }
-  // save/load an ini-file
-  if (cmd=="--ctk-save-ini" || cmd=="--ctk-load-ini")
+  // save/load an ini-file or binary file, save the xml description
+  if (cmd=="--ctk-save-ini" || cmd=="--ctk-save-ini-delta" || cmd=="--ctk-load-ini" || cmd=="--ctk-save-bin" || cmd=="--ctk-load-bin" || cmd=="--ctk-save-xml"
+    || cmd=="--ctk-publish-shared" || cmd=="--ctk-attach-shared")
   {
    if (i==*argc-1)
    {
@@ -296,66 +1026,176 @@ void ctkCmdLineApplication::parseCommandLine(int *argc, char ** argv)
     break;
    }
    argv[i++]=0x0; // mark as handled
-   if (cmd[6]=='s')
-    save(argv[i++]);
+   std::string_view format=cmd.substr(11);
+   if (cmd=="--ctk-publish-shared" || cmd=="--ctk-attach-shared")
+   {
+    if (cmd[6]=='p' ? !publishShared(argv[i]) : !attachShared(argv[i]))
+     std::cerr << "Failed to " << (cmd[6]=='p' ? "write " : "read ") << argv[i] << std::endl;
+   }
+   else if (cmd[6]=='s')
+   {
+    if (format=="ini" || format=="ini-delta")
+     save(argv[i],format=="ini" ? SaveAll : SaveNonDefault);
+    else if (format=="bin" ? !saveBinary(argv[i]) : !saveXMLDescription(argv[i]))
+     std::cerr << "Failed to write " << argv[i] << std::endl;
+   }
+   else if (format=="ini" && prefetched && nextIni<iniFiles.size() && iniArgs[nextIni]==i)
+   {
+    if (!load(*prefetched->take(nextIni++),argv[i]))
+     std::cerr << "Failed to read " << argv[i] << std::endl;
+   }
    else
-    load(argv[i++]);
+   {
+    if (format=="bin" ? !loadBinary(argv[i]) : !load(std::string(argv[i])))
+     std::cerr << "Failed to read " << argv[i] << std::endl;
+   }
+   argv[i]=0x0;
    continue;
   }
-  // Command Line arguments start with '-' or "--".
-  if (cmd[0]=='-')
+  // save measurements at exit
+  if (cmd=="--ctk-profile")
   {
-   // after the flag we expect a value
    if (i==*argc-1)
    {
     std::cerr << "Expected value but found end of argument list.\n";
     std::cerr << "Ignored command line argument " << cmd << std::endl;
     break;
    }
-   argv[i]=0x0; // mark as handled
+   argv[i++]=0x0; // mark as handled
+#ifdef CTK_CLI_PROFILING
+   // the main instance saves at exit, others when destroyed
+   if (this==&mainInstance && profiling.outputFile.empty())
+    std::atexit(saveProfileAtExit);
+   profiling.outputFile=argv[i];
+#else
+   std::cerr << "Ignored command line argument --ctk-profile: compiled without CTK_CLI_PROFILING." << std::endl;
+#endif
+   argv[i]=0x0;
+   continue;
   }
-  else
+  // batch mode runs after all other arguments have been applied
+  if (cmd=="--ctk-batch" || cmd=="--ctk-batch-threads" || cmd=="--ctk-serve")
   {
-   // Since this argument does not start with '-' we assign an index.
-   cmd=ctkCLI::toString(index++);
+   if (i==*argc-1)
+   {
+    std::cerr << "Expected value but found end of argument list.\n";
+    std::cerr << "Ignored command line argument " << cmd << std::endl;
+    break;
+   }
+   argv[i++]=0x0; // mark as handled
+   if (cmd=="--ctk-batch")
+    batchFile=argv[i];
+   else if (cmd=="--ctk-serve")
+    serveAt=argv[i];
+   else if (!ctkCLI::stringTo(argv[i],batchThreads))
+    std::cerr << "Invalid value " << argv[i] << " for command line argument " << cmd << std::endl;
+   argv[i]=0x0;
+   continue;
   }
-  if (commandLineFlags.find(cmd)!=commandLineFlags.end())
+  // Since this argument does not start with '-' we assign an index. It is left in argv.
+  if (cmd.empty() || cmd[0]!='-')
   {
-   ctkCLI::ctkParamDataInterface *p=
-    param[commandLineFlags[cmd].first][commandLineFlags[cmd].second];
-   if (p->getType()==ctkCLI::getTypeName<bool>())
-    p->setString(ctkCLI::toString(!ctkCLI::stringTo<bool>(p->getString())));
-   else
-    p->setString(argv[i]);
+   int id=registry.findIndexed(index++);
+   willChange(id);
+   if (id>=0 && registry[id].data && !registry[id].data->setString(cmd))
+   {
+    std::cerr << "Invalid value " << cmd << " for command line argument " << index-1 << std::endl;
+    valid=false;
+   }
+   continue;
   }
-  else if (cmd[0]=='-') // warn only for unknown flags and leave additional unhandled arguments alone 
+  // Command Line arguments start with '-' or "--".
+  int id=registry.findFlag(cmd);
+  if (id<0 || !registry[id].data)
+  {
+   // warn only for unknown flags and leave additional unhandled arguments alone
    std::cerr << "Ignored command line argument " << cmd << std::endl;
-  i++; // we handled the current argument and now use the next as our data
- }
- // Finally, remove handled arguments from argv
- int handled=0;
- for (int i=0;i<*argc;i++)
- {
-  if (argv[i]==0x0)
+   continue;
+  }
+  ctkCLI::ctkParamDataInterface *p=registry[id].data;
+  willChange(id);
+  // boolean flags toggle the value
+  ctkCLI::ctkParamValue<bool> *b=ctkCLI::valueOf<bool>(p);
+  if (b)
   {
-   handled++;
-   argv[i]=argv[i+handled];
-   i--;
+   b->set(!b->get());
+   argv[i]=0x0; // mark as handled
+   continue;
   }
- }
- argc-=handled;
+  // after the flag we expect a value
+  if (i==*argc-1)
+  {
+   std::cerr << "Expected value but found end of argument list.\n";
+   std::cerr << "Ignored command line argument " << cmd << std::endl;
+   break;
+  }
+  argv[i++]=0x0; // mark as handled
+  if (!p->setString(argv[i]))
+  {
+   std::cerr << "Invalid value " << argv[i] << " for command line argument " << cmd << std::endl;
+   valid=false;
+  }
+  argv[i]=0x0;
+ }
+ parsing=false;
+ endChanges();
+ if (!describing && !validate())
+  valid=false;
+ if (!batchFile.empty())
+ {
+  if (!batchCallback)
+   std::cerr << "Ignored command line argument --ctk-batch: this application does not support batch mode." << std::endl;
+  else if (runBatchFile(batchFile,batchCallback,batchThreads)<0)
+   std::cerr << "Failed to read " << batchFile << std::endl;
+  else
+   batchRan=true;
+ }
+ if (!serveAt.empty())
+ {
+  if (!batchCallback)
+   std::cerr << "Ignored command line argument --ctk-serve: this application does not support batch mode." << std::endl;
+  else if (serve(serveAt,batchCallback)<0)
+   std::cerr << "Failed to serve at " << serveAt << std::endl;
+  else
+   batchRan=true;
+ }
+ // Finally, remove handled arguments from argv, keeping the order of the remaining ones
+ int remaining=0;
+ for (int i=0;i<*argc;i++)
+  if (argv[i]!=0x0)
+   argv[remaining++]=argv[i];
+ // argv is null terminated, just like the arguments to main(...)
+ if (remaining<*argc)
+  argv[remaining]=0x0;
+ *argc=remaining;
+ return valid;
+}
+
+//----------------------------------------------------------------------------
+
+bool ctkCmdLineApplication::parse(std::string_view ini, const std::string& source)
+{
+ return parseIni(ini,source,0x0,LayerDefault);
 }
 
 //----------------------------------------------------------------------------
 
-void ctkCmdLineApplication::parse(const std::string& ini)
+bool ctkCmdLineApplication::parseIni(std::string_view ini, const std::string& source, std::vector<LayerValue>* found, Layer layer)
 {
- std::string list="Global";
- std::istringstream strstr(ini);
- for (int lineNumber=0; !strstr.eof(); lineNumber++)
+ CTK_PROFILE_PHASE(profiling,"parse");
+ // all changes of the parsed values are notified at once
+ beginChanges();
+ bool ok=true;
+ // text to append to messages about a line
+ std::string in=source.empty() ? std::string() : " of "+source;
+ std::string_view list="Global";
+ for (std::string_view::size_type pos=0, lineNumber=1; pos<ini.length(); lineNumber++)
  {
-  std::string line;
-  getline(strstr,line,'\n');
+  // the lines are only referenced, never copied
+  std::string_view::size_type end=ini.find('\n',pos);
+  if (end==std::string_view::npos) end=ini.length();
+  std::string_view line=ctkCLI::trimmed(ini.substr(pos,end-pos)," \t\r");
+  pos=end+1;
   // ignore comments and empty lines
   if (line.length()<2 || line[0]=='#')
    continue;
@@ -364,206 +1204,1092 @@ void ctkCmdLineApplication::parse(const std::string& ini)
    list=line.substr(1,line.length()-2);
    continue;
   }
-  std::istringstream linestr(line);
-  std::string key,value;
-  getline(linestr,key,'=');
-  getline(linestr,value,'\0');
-  ctkCLI::trim(key);
-  ctkCLI::trim(value);
-  param[list][key]->setString(value);
+  std::string_view::size_type eq=line.find('=');
+  if (eq==std::string_view::npos)
+  {
+   std::cerr << "Expected key = value in line " << lineNumber << in << std::endl;
+   ok=false;
+   continue;
+  }
+  std::string_view key=ctkCLI::trimmed(line.substr(0,eq));
+  std::string_view value=ctkCLI::trimmed(line.substr(eq+1));
+  int id=registry.find(list,key);
+  if (id<0 || !registry[id].data)
+  {
+   std::cerr << "Ignored unknown parameter [" << list << "] " << key << " in line " << lineNumber << in << std::endl;
+   ok=false;
+  }
+  else if (found)
+  {
+   // the last of several values wins, just like when assigning them
+   LayerValue& v=(*found)[id];
+   v.value=value;
+   v.layer=layer;
+   v.line=(int)lineNumber;
+  }
+  else
+  {
+   willChange(id);
+   if (!assign(id,value,source))
+   {
+    std::cerr << "Invalid value " << value << " for [" << list << "] " << key << " in line " << lineNumber << in << std::endl;
+    ok=false;
+   }
+  }
  } // for lines
+ endChanges();
+ return ok;
 }
 
 //----------------------------------------------------------------------------
 
 bool ctkCmdLineApplication::load(const std::string& iniFile)
 {
- // read complete contents of file into string
- std::ifstream file(iniFile.c_str());
- if (!file.is_open() || !file.good())
- {
-  file.clear();
+ CTK_PROFILE_PHASE(profiling,"load");
+ return load(ctkCLI::ctkMappedFile(iniFile),iniFile);
+}
+
+//----------------------------------------------------------------------------
+
+bool ctkCmdLineApplication::assign(int id, std::string_view value, const std::string& source)
+{
+ ctkCLI::ctkParamDataInterface* p=registry[id].data;
+ // (a numeric vector never starts with '@', so there is no ambiguity)
+ if (value.empty() || value[0]!='@' || !(p->kind==ctkCLI::ctkValueIntVector || p->kind==ctkCLI::ctkValueFloatVector || p->kind==ctkCLI::ctkValueDoubleVector))
+  return p->setString(value);
+ std::filesystem::path sidecar(value.substr(1));
+ if (sidecar.is_relative() && !source.empty())
+  sidecar=std::filesystem::path(source).parent_path()/sidecar;
+ ctkCLI::ctkMappedFile file(sidecar.string());
+ ctkCLI::ctkBinaryReader reader;
+ if (!file.is_open() || !reader.open(file.data()) || reader.size()!=1)
   return false;
- }
- std::string all;
- getline(file,all,'\0');
- file.close();
- // and parse it
- parse(all);
+ return p->readBinary(reader.type(0),reader.value(0));
+}
+
+//----------------------------------------------------------------------------
+
+bool ctkCmdLineApplication::load(const ctkCLI::ctkMappedFile& file, const std::string& iniFile)
+{
+ if (!file.is_open())
+  return false;
+ // the file is parsed right from memory
+ parse(file.data(),iniFile);
+ if (!parsing)
+  validate();
  return true;
 }
 
 //----------------------------------------------------------------------------
 
-void ctkCmdLineApplication::save(const std::string& iniFile) const
+bool ctkCmdLineApplication::load(const std::vector<std::string>& iniFiles)
 {
- std::ofstream file(iniFile.c_str());
- for (MapIteratorStrStrParam it=param.begin();it!=param.end();++it)
+ CTK_PROFILE_PHASE(profiling,"load");
+ ctkCLI::ctkFilePrefetch files(iniFiles);
+ bool ok=true, wasParsing=parsing;
+ parsing=true;
+ beginChanges();
+ for (std::size_t i=0;i<iniFiles.size();i++)
+  if (!load(*files.take(i),iniFiles[i]))
   {
-   file << "\n[" << it->first << "]\n\n";
-   for (MapIteratorStrParam pit=it->second.begin();pit!=it->second.end();++pit)
-    file << pit->first << " = " << pit->second->getString() << "\n";
-   file << "\n\n";
+   std::cerr << "Failed to read " << iniFiles[i] << std::endl;
+   ok=false;
   }
- file.close();
+ endChanges();
+ parsing=wasParsing;
+ if (!parsing)
+  validate();
+ return ok;
 }
 
 //----------------------------------------------------------------------------
 
-std::string ctkCmdLineApplication::getXMLDescription() const
+std::string ctkCmdLineApplication::environmentName(std::string_view section, std::string_view key)
 {
- // order of slicer tags in an XML file (whatever the reason that they require this ordering)
- const int num_app_tag=8;
- const char *app_tags[]={
-   "category",
-   "title",
-   "description",
-   "version",
-   "documentation-url",
-   "license",
-   "contributor",
-   "acknowledgements"
-  };
- std::ostringstream xml;
- // Name (titel) and category of the app
- xml << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
- xml << "<executable>\n";
- // All other tags ("license", "documentation-url" etc.)
- for (int i=0;i<num_app_tag;i++)
-  if (tags.find(app_tags[i])!=tags.end())
-   xml << "  <" << app_tags[i] << ">" << tags.find(app_tags[i])->second << "</" << app_tags[i] << ">\n";
- // The "parameters"
- for (MapIteratorStrStrParam sit=param.begin();sit!=param.end();++sit)
- {
-  xml << "  <parameters>\n"; // advanced="true|false" missing
-  xml << "    <label>" << sit->first << "</label>\n";
-  xml << "    <description>" << sit->first << " - Section" << "</description>\n";
-  for (MapIteratorStrParam kit=sit->second.begin();kit!=sit->second.end();++kit)
-  {
-   ctkCLI::ctkParamDataInterface &p=*(kit->second);
-   // define type and attributes, such as "fileExtensions" etc.
-   xml << "    <" << p.getType();
-   for (MapIteratorStrStr ait=p.attribs.begin();ait!=p.attribs.end();++ait)
-    if (!ait->second.empty())
-     xml << " " << ait->first << "=\"" << ait->second << "\"";
-   xml<< ">\n";
-   xml << "      <name>" << kit->first << "</name>\n";
-   // Define "defult" value (note: uses the current value of the parameter)
-   xml << "      <default>" << p.getString() << "</default>\n";
-   // Define additional tag such as "description", "flag" etc.
-   for (MapIteratorStrStr it=p.tags.begin();it!=p.tags.end();++it)
+ std::string name="CTK_";
+ name.append(section).append(1,'_').append(key);
+ for (std::size_t i=4;i<name.length();i++)
+  name[i]=std::isalnum((unsigned char)name[i]) ? (char)std::toupper((unsigned char)name[i]) : '_';
+ return name;
+}
+
+//----------------------------------------------------------------------------
+
+bool ctkCmdLineApplication::resolve(int *argc, char ** argv, const std::string& systemIni, const std::string& userIni)
+{
+ CTK_PROFILE_PHASE(profiling,"resolve");
+ if (!defaultValues)
+  setDefaults();
+ int n=registry.size();
+ LayerValue none={std::string_view(),LayerDefault,0};
+ std::vector<LayerValue> found(n,none);
+ // the files are read concurrently and stay mapped until the values, which are only referenced, have been assigned
+ const std::string* iniFiles[2]={&systemIni,&userIni};
+ std::vector<std::string> paths;
+ for (int f=0;f<2;f++)
+  if (!iniFiles[f]->empty())
+   paths.push_back(*iniFiles[f]);
+ ctkCLI::ctkFilePrefetch prefetched(paths);
+ std::unique_ptr<ctkCLI::ctkMappedFile> files[2];
+ for (int f=0, k=0;f<2;f++)
+ {
+  if (iniFiles[f]->empty())
+   continue;
+  files[f]=prefetched.take(k++);
+  // missing configuration files are no error
+  if (files[f]->is_open())
+   parseIni(files[f]->data(),*iniFiles[f],&found,f==0 ? LayerSystem : LayerUser);
+ }
+ std::vector<std::string> envNames(n);
+ for (int id=0;id<n;id++)
+ {
+  if (!registry[id].data)
+   continue;
+  envNames[id]=environmentName(registry.getSection(id),registry[id].key);
+  const char* env=std::getenv(envNames[id].c_str());
+  if (env)
+  {
+   found[id].value=env;
+   found[id].layer=LayerEnvironment;
+  }
+ }
+ // find the parameters the command line assigns, following parseCommandLine, so that lower layers are not converted for them
+ std::vector<int> fromCommandLine;
+ for (int i=1, index=0;i<*argc;i++)
+ {
+  std::string_view cmd(argv[i]);
+  bool indexed=cmd.empty() || cmd[0]!='-';
+  int id=-1;
+  if (indexed)
+   id=registry.findIndexed(index++);
+  else if ((id=registry.findFlag(cmd))<0)
+  {
+   // all options of ctkCmdLineApplication but these take a value
+   if (cmd.substr(0,6)=="--ctk-")
+    i++;
+   continue;
+  }
+  if (id<0 || !registry[id].data)
+   continue;
+  fromCommandLine.push_back(id);
+  // indexed arguments and flags with a value replace the value of the lower layers, boolean flags toggle it
+  if (indexed)
+   found[id].layer=LayerCommandLine;
+  else if (!ctkCLI::valueOf<bool>(registry[id].data))
+  {
+   found[id].layer=LayerCommandLine;
+   i++;
+  }
+ }
+ // assign each parameter from the winning layer and the command line, then notify and validate once
+ bool valid=true;
+ beginChanges();
+ for (int id=0;id<n;id++)
+ {
+  const LayerValue& v=found[id];
+  if (v.layer==LayerDefault || v.layer==LayerCommandLine || !registry[id].data)
+   continue;
+  willChange(id);
+  if (!assign(id,v.value,v.layer==LayerEnvironment ? std::string() : *iniFiles[v.layer==LayerSystem ? 0 : 1]))
+  {
+   std::cerr << "Invalid value " << v.value << " for [" << registry.getSection(id) << "] " << registry[id].key;
+   if (v.layer==LayerEnvironment)
+    std::cerr << " in environment variable " << envNames[id] << std::endl;
+   else
+    std::cerr << " in line " << v.line << " of " << *iniFiles[v.layer==LayerSystem ? 0 : 1] << std::endl;
+   valid=false;
+  }
+ }
+ layers.resize(n);
+ for (int id=0;id<n;id++)
+  layers[id]=found[id].layer;
+ for (std::size_t i=0;i<fromCommandLine.size();i++)
+  layers[fromCommandLine[i]]=LayerCommandLine;
+ if (!parseCommandLine(argc,argv))
+  valid=false;
+ endChanges();
+ return valid;
+}
+
+//----------------------------------------------------------------------------
+
+void ctkCmdLineApplication::currentValue(const ctkCLI::ctkParamDataInterface& p, std::string& out)
+{
+ out.clear();
+ if (p.lazy) out=p.getString();
+ else p.writeBinary(out);
+}
+
+//----------------------------------------------------------------------------
+
+int ctkCmdLineApplication::observe(const std::string& section, const std::string& key, const ChangeCallback& callback)
+{
+ Observer observer;
+ observer.handle=nextObserver++;
+ observer.section=section;
+ observer.key=key;
+ observer.callback=callback;
+ observers.push_back(observer);
+ return observer.handle;
+}
+
+//----------------------------------------------------------------------------
+
+int ctkCmdLineApplication::observe(const std::vector<int>& ids, const ChangeCallback& callback)
+{
+ Observer observer;
+ observer.handle=nextObserver++;
+ observer.ids=ids;
+ std::sort(observer.ids.begin(),observer.ids.end());
+ observer.callback=callback;
+ observers.push_back(observer);
+ return observer.handle;
+}
+
+//----------------------------------------------------------------------------
+
+void ctkCmdLineApplication::unobserve(int observer)
+{
+ for (std::size_t i=0;i<observers.size();i++)
+  if (observers[i].handle==observer)
+  {
+   observers.erase(observers.begin()+i);
+   return;
+  }
+}
+
+//----------------------------------------------------------------------------
+
+void ctkCmdLineApplication::dispatchChanges()
+{
+ // observers may change parameters themselves, which is notified in another round (up to a limit, in case of cycles)
+ for (int round=0;round<16 && changeDepth==0 && !pendingIds.empty();round++)
+ {
+  CTK_PROFILE_PHASE(profiling,"notifyChanges");
+  std::vector<int> changed;
+  std::string value;
+  for (std::size_t i=0;i<pendingIds.size();i++)
+  {
+   int id=pendingIds[i];
+   pending[id]=false;
+   if (!registry[id].data) continue;
+   currentValue(*registry[id].data,value);
+   if (value!=pendingValues[i])
+    changed.push_back(id);
+  }
+  pendingIds.clear();
+  pendingValues.clear();
+  if (changed.empty())
+   return;
+  std::sort(changed.begin(),changed.end());
+  // callbacks may add or remove observers, so they are called on a copy
+  std::vector<Observer> called=observers;
+  changeDepth++;
+  for (std::size_t o=0;o<called.size();o++)
+  {
+   const Observer& observer=called[o];
+   std::vector<int> relevant;
+   for (std::size_t i=0;i<changed.size();i++)
+   {
+    int id=changed[i];
+    bool depends=observer.section.empty()
+     ? std::binary_search(observer.ids.begin(),observer.ids.end(),id)
+     : registry.getSection(id)==observer.section && (observer.key.empty() || registry[id].key==observer.key);
+    if (depends) relevant.push_back(id);
+   }
+   if (!relevant.empty())
+    observer.callback(relevant);
+  }
+  changeDepth--;
+ }
+}
+
+//----------------------------------------------------------------------------
+
+bool ctkCmdLineApplication::validate(int threads) const
+{
+ CTK_PROFILE_PHASE(profiling,"validate");
+ if (!checksValid)
+ {
+  checks.clear();
+  for (int id=0;id<registry.size();id++)
+  {
+   const ctkCLI::ctkParamDataInterface* p=registry[id].data;
+   if (!p) continue;
+   ctkCLI::ctkParamCheck check(id,p->getType(),p->tags,p->attribs,p->constraints);
+   if (check.any()) checks.push_back(std::move(check));
+  }
+  checksValid=true;
+ }
+ bool ok=true;
+ // checks of the filesystem are collected and run at once
+ std::vector<const ctkCLI::ctkParamCheck*> filesystem;
+ std::vector<std::string> values;
+ for (std::size_t i=0;i<checks.size();i++)
+ {
+  std::string value=registry[checks[i].id].data->getString();
+  std::string error=checks[i].check(value);
+  if (!error.empty())
+  {
+   std::cerr << "Invalid value " << value << " for parameter " << registry[checks[i].id].name << ": " << error << std::endl;
+   ok=false;
+  }
+  else if (checks[i].filesystem() && !value.empty())
+  {
+   filesystem.push_back(&checks[i]);
+   values.push_back(value);
+  }
+ }
+ if (filesystem.empty())
+  return ok;
+ std::vector<std::string> errors=ctkCLI::checkFilesystem(filesystem,values,threads);
+ for (std::size_t i=0;i<errors.size();i++)
+  if (!errors[i].empty())
+  {
+   std::cerr << "Invalid value " << values[i] << " for parameter " << registry[filesystem[i]->id].name << ": " << errors[i] << std::endl;
+   ok=false;
+  }
+ return ok;
+}
+
+//----------------------------------------------------------------------------
+
+void ctkCmdLineApplication::save(const std::string& iniFile, SaveMode mode) const
+{
+ CTK_PROFILE_PHASE(profiling,"save");
+ std::string out, value;
+ const std::vector<int>& ids=registry.ordered();
+ // parameters are sorted by section, so each section is a contiguous range of ids
+ for (IteratorId it=ids.begin();it!=ids.end();)
+  {
+   int section=registry[*it].section;
+   std::size_t head=out.length();
+   bool any=false;
+   out+="\n[";
+   out+=registry.getSection(*it);
+   out+="]\n\n";
+   for (;it!=ids.end() && registry[*it].section==section;++it)
    {
-    if (it->second.empty()) continue;
-    // special case: "enumeration" tag has child-nodes for items
-    if (it->first=="enumeration")
+    const ctkCLI::ctkParamDataInterface& p=*registry[*it].data;
+    bool changed=mode==SaveAll || (mode==SaveChanged && p.dirty);
+    if (mode==SaveNonDefault)
+    {
+     // values are compared in their binary representation
+     int type;
+     std::string_view defaultValue;
+     value.clear();
+     p.writeBinary(value);
+     changed=!defaultValues || !defaultValues->getBinary(*it,type,defaultValue) || type!=p.getBinaryType() || defaultValue!=value;
+    }
+    p.dirty=false;
+    if (!changed) continue;
+    out+=registry[*it].key;
+    out+=" = ";
+    bool sidecar=sidecarBytes && (p.kind==ctkCLI::ctkValueIntVector || p.kind==ctkCLI::ctkValueFloatVector || p.kind==ctkCLI::ctkValueDoubleVector);
+    if (sidecar)
     {
-     std::vector<std::string> enumeration=ctkCLI::stringToVector<std::string>(it->second,',');
-     if (!enumeration.empty())
-     {
-      xml << "      <enumeration>\n";
-      for (std::vector<std::string>::const_iterator
-       cit=enumeration.begin();cit!=enumeration.end();++cit)
-        xml << "        <element>" << *cit << "</element>\n";
-      xml << "      </enumeration>\n";
-     }
+     value.clear();
+     p.writeBinary(value);
+     sidecar=value.length()>sidecarBytes;
+    }
+    if (sidecar)
+    {
+     // large numeric vectors are stored in binary next to the ini-file
+     ctkCLI::ctkBinaryWriter writer;
+     writer.add(registry[*it].name,p.getBinaryType())=value;
+     std::string sidecarFile=iniFile+"."+std::string(registry[*it].name)+".bin";
+     std::ofstream file(sidecarFile.c_str(),std::ios::out|std::ios::binary);
+     std::string contents=writer.str(0);
+     if (!file.write(contents.data(),contents.length()))
+      std::cerr << "Failed to write " << sidecarFile << std::endl;
+     out+="@";
+     out+=std::filesystem::path(sidecarFile).filename().string();
     }
     else
-     xml << "      <" << it->first << ">" << it->second << "</" << it->first << ">\n"; 
+     out+=p.getString();
+    out+="\n";
+    any=true;
    }
-   // finally, "constraints" tag is also a special case with child-nodes
-   if (!p.constraints.empty())
+   // sections without any parameters to write are left out
+   if (any) out+="\n\n";
+   else out.resize(head);
+  }
+ std::ofstream file(iniFile.c_str());
+ file.write(out.data(),out.length());
+ file.close();
+}
+
+//----------------------------------------------------------------------------
+
+void ctkCmdLineApplication::setDefaults()
+{
+ defaultValues.reset(takeSnapshot(0));
+ for (int id=0;id<registry.size();id++)
+  if (registry[id].data)
+   registry[id].data->dirty=false;
+}
+
+//----------------------------------------------------------------------------
+
+bool ctkCmdLineApplication::loadBinary(const std::string& binFile)
+{
+ CTK_PROFILE_PHASE(profiling,"loadBinary");
+ ctkCLI::ctkMappedFile file(binFile);
+ return file.is_open() && setBinary(file.data(),binFile);
+}
+
+//----------------------------------------------------------------------------
+
+bool ctkCmdLineApplication::setBinary(std::string_view contents, const std::string& source)
+{
+ ctkCLI::ctkBinaryReader reader;
+ if (!reader.open(contents))
+  return false;
+ beginChanges();
+ for (int i=0;i<reader.size();i++)
+ {
+  int id=registry.findName(reader.name(i));
+  if (id<0 || !registry[id].data)
+  {
+   std::cerr << "Ignored unknown parameter " << reader.name(i) << " in " << source << std::endl;
+   continue;
+  }
+  willChange(id);
+  if (!registry[id].data->readBinary(reader.type(i),reader.value(i)))
+   std::cerr << "Ignored parameter " << reader.name(i) << " of different type in " << source << std::endl;
+ }
+ endChanges();
+ return true;
+}
+
+//----------------------------------------------------------------------------
+
+std::string ctkCmdLineApplication::getBinary(std::uint64_t gen, bool inputsOnly) const
+{
+ ctkCLI::ctkBinaryWriter writer;
+ for (int id=0;id<registry.size();id++)
+ {
+  const ctkCLI::ctkParamDataInterface* p=registry[id].data;
+  if (!p) continue;
+  if (inputsOnly)
+  {
+   MapIteratorStrStr channel=p->tags.find("channel");
+   if (channel==p->tags.end() || channel->second!="input") continue;
+  }
+  p->writeBinary(writer.add(registry[id].name,p->getBinaryType()));
+ }
+ return writer.str(gen);
+}
+
+//----------------------------------------------------------------------------
+
+std::uint64_t ctkCmdLineApplication::getHash(bool inputsOnly) const
+{
+ CTK_PROFILE_PHASE(profiling,"getHash");
+ return ctkCLI::binaryHash(getBinary(0,inputsOnly));
+}
+
+//----------------------------------------------------------------------------
+
+std::vector<std::string> ctkCmdLineApplication::diff(std::string_view binary, bool inputsOnly) const
+{
+ CTK_PROFILE_PHASE(profiling,"diff");
+ return ctkCLI::binaryDiff(getBinary(0,inputsOnly),binary);
+}
+
+//----------------------------------------------------------------------------
+
+bool ctkCmdLineApplication::saveBinary(const std::string& binFile) const
+{
+ CTK_PROFILE_PHASE(profiling,"saveBinary");
+ std::string contents=getBinary();
+ std::ofstream file(binFile.c_str(),std::ios::out|std::ios::binary);
+ file.write(contents.data(),contents.length());
+ return file.good();
+}
+
+//----------------------------------------------------------------------------
+
+std::vector<std::string_view> ctkCmdLineApplication::getNames() const
+{
+ std::vector<std::string_view> names(registry.size());
+ for (int id=0;id<registry.size();id++)
+  if (registry[id].data)
+   names[id]=registry[id].name;
+ return names;
+}
+
+//----------------------------------------------------------------------------
+
+ctkCLI::ctkParamSnapshot* ctkCmdLineApplication::takeSnapshot(std::uint64_t gen) const
+{
+ return new ctkCLI::ctkParamSnapshot(getBinary(gen),getNames());
+}
+
+//----------------------------------------------------------------------------
+
+std::uint64_t ctkCmdLineApplication::readGeneration(const std::string& binFile)
+{
+ ctkCLI::ctkBinaryHeader header;
+ std::ifstream file(binFile.c_str(),std::ios::in|std::ios::binary);
+ if (!file.read(reinterpret_cast<char*>(&header),sizeof(header)))
+  return 0;
+ if (std::memcmp(header.magic,ctkCLI::ctkBinaryMagic,sizeof(header.magic))!=0 || header.version!=ctkCLI::ctkBinaryVersion)
+  return 0;
+ return header.generation;
+}
+
+//----------------------------------------------------------------------------
+
+std::uint64_t ctkCmdLineApplication::publishShared(const std::string& binFile)
+{
+ CTK_PROFILE_PHASE(profiling,"publishShared");
+ // attached processes recognize a new file by its generation
+ std::uint64_t gen=std::max(readGeneration(binFile),generation)+1;
+ std::string contents=getBinary(gen);
+ std::string tmpFile=binFile+".tmp";
+ {
+  std::ofstream file(tmpFile.c_str(),std::ios::out|std::ios::binary);
+  file.write(contents.data(),contents.length());
+  if (!file.good())
+  {
+   file.close();
+   std::remove(tmpFile.c_str());
+   return 0;
+  }
+ }
+ // replaces binFile atomically on POSIX systems, else binFile has to go first
+ if (std::rename(tmpFile.c_str(),binFile.c_str())!=0)
+ {
+  std::remove(binFile.c_str());
+  if (std::rename(tmpFile.c_str(),binFile.c_str())!=0)
+  {
+   std::remove(tmpFile.c_str());
+   return 0;
+  }
+ }
+ generation=gen;
+ return gen;
+}
+
+//----------------------------------------------------------------------------
+
+bool ctkCmdLineApplication::attachShared(const std::string& binFile)
+{
+ CTK_PROFILE_PHASE(profiling,"attachShared");
+ std::unique_ptr<ctkCLI::ctkMappedFile> file(new ctkCLI::ctkMappedFile(binFile));
+ if (!file->is_open())
+  return false;
+ std::unique_ptr<ctkCLI::ctkParamSnapshot> snapshot(new ctkCLI::ctkParamSnapshot(std::move(file),getNames()));
+ if (!snapshot->is_valid())
+  return false;
+ sharedFile=binFile;
+ sharedGeneration=snapshot->generation();
+ snapshots.publish(snapshot.release());
+ return true;
+}
+
+//----------------------------------------------------------------------------
+
+bool ctkCmdLineApplication::refreshShared()
+{
+ if (sharedFile.empty())
+  return false;
+ std::uint64_t gen=readGeneration(sharedFile);
+ if (gen==0 || gen==sharedGeneration)
+  return false;
+ return attachShared(sharedFile);
+}
+
+//----------------------------------------------------------------------------
+
+std::uint64_t ctkCmdLineApplication::publish()
+{
+ CTK_PROFILE_PHASE(profiling,"publish");
+ snapshots.publish(takeSnapshot(++generation));
+ return generation;
+}
+
+//----------------------------------------------------------------------------
+
+int ctkCmdLineApplication::runBatch(std::string_view sets, const BatchCallback& callback, int threads, const std::string& source)
+{
+ // the current values are the defaults of each set, thus observers are not notified of the sets (see observe)
+ beginChanges();
+ std::string defaults=getBinary();
+ std::string in=source.empty() ? std::string("batch") : source;
+ // with threads, the values of all sets are collected first, then evaluated concurrently
+ std::vector<std::unique_ptr<const ctkCLI::ctkParamSnapshot> > values;
+ std::vector<int> numbers;
+ int set=0, evaluated=0;
+ // sets are separated by lines "---"
+ for (std::string_view::size_type pos=0, begin=0; begin<=sets.length(); )
+ {
+  std::string_view::size_type end=sets.find('\n',pos);
+  if (end==std::string_view::npos) end=sets.length();
+  bool separator=ctkCLI::trimmed(sets.substr(pos,end-pos)," \t\r")=="---";
+  if (!separator && end<sets.length())
+  {
+   pos=end+1;
+   continue;
+  }
+  std::string_view block=sets.substr(begin,(separator ? pos : end)-begin);
+  begin=pos=end+1;
+  if (ctkCLI::trimmed(block," \t\r\n").empty())
+   continue;
+  setBinary(defaults,in);
+  if (!parse(block,in+" (set "+ctkCLI::toString(set)+")"))
+  {
+   std::cerr << "Skipped parameter set " << set << " of " << in << std::endl;
+   set++;
+   continue;
+  }
+  std::unique_ptr<const ctkCLI::ctkParamSnapshot> snapshot(takeSnapshot(set));
+  if (threads>1)
+  {
+   values.push_back(std::move(snapshot));
+   numbers.push_back(set);
+  }
+  else
+   callback(set,*snapshot);
+  set++;
+  evaluated++;
+ }
+ setBinary(defaults,in);
+ if (!values.empty())
+ {
+  // a simple pool: each thread takes the next set until all are done
+  std::atomic<int> next(0);
+  std::vector<std::thread> pool;
+  for (int t=0;t<threads && t<(int)values.size();t++)
+   pool.push_back(std::thread([&]() {
+    for (int i=next++;i<(int)values.size();i=next++)
+     callback(numbers[i],*values[i]);
+   }));
+  for (std::size_t t=0;t<pool.size();t++)
+   pool[t].join();
+ }
+ endChanges();
+ return evaluated;
+}
+
+//----------------------------------------------------------------------------
+
+int ctkCmdLineApplication::serve(const std::string& where, const BatchCallback& callback)
+{
+ // the current values are the defaults of each request, thus observers are not notified of the requests (see observe)
+ std::string defaults=getBinary();
+ int count=0;
+ if (where=="-")
+ {
+  ctkCLI::ctkRequestStream stream;
+  beginChanges();
+  serveRequests(stream,callback,defaults,count);
+  endChanges();
+  return count;
+ }
+#ifndef _WIN32
+ ctkCLI::ctkUnixServer server(where);
+ if (!server.is_open())
+  return -1;
+ beginChanges();
+ // one connection after the other, until a request "quit" or an error
+ for (;;)
+ {
+  int fd=server.accept();
+  if (fd<0)
+  {
+   std::cerr << "Failed to accept a connection at " << where << std::endl;
+   break;
+  }
+  ctkCLI::ctkRequestStream stream(fd);
+  if (!serveRequests(stream,callback,defaults,count))
+   break;
+ }
+ endChanges();
+ return count;
+#else
+ std::cerr << "Unix sockets are not supported on this platform." << std::endl;
+ return -1;
+#endif
+}
+
+//----------------------------------------------------------------------------
+
+bool ctkCmdLineApplication::serveRequests(ctkCLI::ctkRequestStream& stream, const BatchCallback& callback, const std::string& defaults, int& count)
+{
+ std::string request;
+ bool binary;
+ bool more=true;
+ while (more && stream.next(request,binary))
+ {
+  if (!binary && ctkCLI::trimmed(request," \t\r\n")=="quit")
+  {
+   stream.write("ok quit\n");
+   more=false;
+   break;
+  }
+  std::string source="request "+ctkCLI::toString(count);
+  setBinary(defaults,source);
+  bool ok=binary ? setBinary(request,source) : parse(request,source);
+  if (ok)
+  {
+   std::unique_ptr<const ctkCLI::ctkParamSnapshot> snapshot(takeSnapshot(count));
+   callback(count,*snapshot);
+  }
+  stream.write((ok ? "ok " : "error ")+ctkCLI::toString(count)+"\n");
+  count++;
+ }
+ setBinary(defaults,"defaults");
+ return more;
+}
+
+//----------------------------------------------------------------------------
+
+int ctkCmdLineApplication::runBatchFile(const std::string& batchFile, const BatchCallback& callback, int threads)
+{
+ ctkCLI::ctkMappedFile file(batchFile);
+ if (!file.is_open())
+  return -1;
+ return runBatch(file.data(),callback,threads,batchFile);
+}
+
+//----------------------------------------------------------------------------
+
+void ctkCmdLineApplication::schemaChanged(int id)
+{
+ checksValid=false;
+ synopsis[0].clear();
+ synopsis[1].clear();
+ if (id<0)
+  xmlHeader.clear();
+ else if (id<(int)xmlValid.size())
+  xmlValid[id]=false;
+}
+
+//----------------------------------------------------------------------------
+
+void ctkCmdLineApplication::describeParam(int id, std::string& head, std::string& tail) const
+{
+ ctkCLI::ctkParamDataInterface &p=*registry[id].data;
+ std::ostringstream xml;
+ // define type and attributes, such as "fileExtensions" etc.
+ xml << "    <" << p.getType();
+ for (MapIteratorStrStr ait=p.attribs.begin();ait!=p.attribs.end();++ait)
+  if (!ait->second.empty())
+   xml << " " << ait->first << "=\"" << ait->second << "\"";
+ xml<< ">\n";
+ xml << "      <name>" << registry[id].key << "</name>\n";
+ // Define "defult" value (note: uses the current value of the parameter, thus it is not part of the cache)
+ xml << "      <default>";
+ head=xml.str();
+ xml.str("");
+ xml << "</default>\n";
+ // Define additional tag such as "description", "flag" etc.
+ for (MapIteratorStrStr it=p.tags.begin();it!=p.tags.end();++it)
+ {
+  if (it->second.empty()) continue;
+  // special case: "enumeration" tag has child-nodes for items
+  if (it->first=="enumeration")
+  {
+   std::vector<std::string> enumeration=ctkCLI::stringToVector<std::string>(it->second,',');
+   if (!enumeration.empty())
    {
-    xml << "      <constraints>\n";
-    for (MapIteratorStrStr cit=p.constraints.begin();cit!=p.constraints.end();++cit)
-     xml << "        <" << cit->first << ">" << cit->second << "</" << cit->first << ">\n";
-    xml << "      </constraints>\n";
+    xml << "      <enumeration>\n";
+    for (std::vector<std::string>::const_iterator
+     cit=enumeration.begin();cit!=enumeration.end();++cit)
+      xml << "        <element>" << *cit << "</element>\n";
+    xml << "      </enumeration>\n";
    }
-   xml << "    </" << p.getType() << ">\n";
   }
-  xml << "  </parameters>\n";
+  else
+   xml << "      <" << it->first << ">" << it->second << "</" << it->first << ">\n"; 
  }
- xml << "</executable>\n";
- return xml.str();
+ // finally, "constraints" tag is also a special case with child-nodes
+ if (!p.constraints.empty())
+ {
+  xml << "      <constraints>\n";
+  for (MapIteratorStrStr cit=p.constraints.begin();cit!=p.constraints.end();++cit)
+   xml << "        <" << cit->first << ">" << cit->second << "</" << cit->first << ">\n";
+  xml << "      </constraints>\n";
+ }
+ xml << "    </" << p.getType() << ">\n";
+ tail=xml.str();
 }
 
 //----------------------------------------------------------------------------
 
-// local utility that formats the verbose help text for an argument
-void printOptionVerbose(std::ostringstream &str, ctkCLI::ctkParamDataInterface& p)
+std::string ctkCmdLineApplication::getXMLDescription() const
 {
- if (p.tags["flag"].empty())
+ CTK_PROFILE_PHASE(profiling,"getXMLDescription");
+ if (!xmlPrecomputed.empty())
+  return xmlPrecomputed;
+ if (xmlHeader.empty())
  {
-  if (p.tags["longflag"].empty())
-   return;
+  // order of slicer tags in an XML file (whatever the reason that they require this ordering)
+  const int num_app_tag=8;
+  const char *app_tags[]={
+    "category",
+    "title",
+    "description",
+    "version",
+    "documentation-url",
+    "license",
+    "contributor",
+    "acknowledgements"
+   };
+  // Name (titel) and category of the app
+  xmlHeader="<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+  xmlHeader+="<executable>\n";
+  // All other tags ("license", "documentation-url" etc.)
+  for (int i=0;i<num_app_tag;i++)
+   if (tags.find(app_tags[i])!=tags.end())
+    xmlHeader+=std::string("  <")+app_tags[i]+">"+tags.find(app_tags[i])->second+"</"+app_tags[i]+">\n";
+ }
+ std::string xml=xmlHeader;
+ // The "parameters". Only those changed since the last call are described anew.
+ xmlValid.resize(registry.size(),false);
+ xmlParts.resize(2*registry.size());
+ const std::vector<int>& ids=registry.ordered();
+ for (IteratorId kit=ids.begin();kit!=ids.end();)
+ {
+  int section=registry[*kit].section;
+  xml+="  <parameters>\n"; // advanced="true|false" missing
+  xml+="    <label>"+registry.getSection(*kit)+"</label>\n";
+  xml+="    <description>"+registry.getSection(*kit)+" - Section"+"</description>\n";
+  for (;kit!=ids.end() && registry[*kit].section==section;++kit)
+  {
+   if (!xmlValid[*kit])
+   {
+    describeParam(*kit,xmlParts[2*(*kit)],xmlParts[2*(*kit)+1]);
+    xmlValid[*kit]=true;
+   }
+   xml+=xmlParts[2*(*kit)];
+   xml+=registry[*kit].data->getString();
+   xml+=xmlParts[2*(*kit)+1];
+  }
+  xml+="  </parameters>\n";
+ }
+ xml+="</executable>\n";
+ return xml;
+}
+
+//----------------------------------------------------------------------------
+
+void ctkCmdLineApplication::writeXMLDescription(std::ostream& out) const
+{
+ if (!xmlPrecomputed.empty())
+  out.write(xmlPrecomputed.data(),xmlPrecomputed.length());
+ else
+  out << getXMLDescription();
+}
+
+//----------------------------------------------------------------------------
+
+bool ctkCmdLineApplication::saveXMLDescription(const std::string& xmlFile) const
+{
+ std::ofstream file(xmlFile.c_str(),std::ios::out|std::ios::binary);
+ writeXMLDescription(file);
+ return file.good();
+}
+
+//----------------------------------------------------------------------------
+
+#ifdef CTK_CLI_PROFILING
+// local utility that quotes a string for JSON
+std::string jsonQuoted(std::string_view str)
+{
+ std::string out="\"";
+ for (std::size_t i=0;i<str.length();i++)
+ {
+  unsigned char c=(unsigned char)str[i];
+  if (c=='"' || c=='\\') { out.push_back('\\'); out.push_back((char)c); }
+  else if (c<0x20) { char hex[8]; std::snprintf(hex,sizeof(hex),"\\u%04x",c); out+=hex; }
+  else out.push_back((char)c);
+ }
+ return out+"\"";
+}
+#endif
+
+//----------------------------------------------------------------------------
+
+std::string ctkCmdLineApplication::getProfileJSON() const
+{
+#ifdef CTK_CLI_PROFILING
+ const ctkCLI::ctkProfile& profile=profiling;
+ std::ostringstream json;
+ json << "{\n \"phases\": {";
+ for (std::map<std::string,ctkCLI::ctkProfilePhase>::const_iterator it=profile.phases.begin();it!=profile.phases.end();++it)
+  json << (it==profile.phases.begin() ? "\n  " : ",\n  ") << jsonQuoted(it->first)
+       << ": {\"calls\": " << it->second.calls << ", \"ns\": " << it->second.ns
+       << ", \"allocations\": " << it->second.allocations << ", \"bytes\": " << it->second.bytes << "}";
+ json << "\n },\n";
+ json << " \"allocations\": " << ctkCLI::ctkProfileCounters::allocations << ",\n";
+ json << " \"bytes\": " << ctkCLI::ctkProfileCounters::bytes << ",\n";
+ json << " \"lookups\": " << ctkCLI::ctkProfileCounters::lookups << ",\n";
+ json << " \"conversions\": " << ctkCLI::ctkProfileCounters::conversions << ",\n";
+ json << " \"parameters\": {";
+ const std::vector<int>& ids=registry.ordered();
+ for (IteratorId it=ids.begin();it!=ids.end();++it)
+  json << (it==ids.begin() ? "\n  " : ",\n  ") << jsonQuoted(registry[*it].name) << ": {\"accesses\": "
+       << (*it<(int)profile.accesses.size() ? profile.accesses[*it] : 0) << "}";
+ json << "\n }\n}\n";
+ return json.str();
+#else
+ return "{}\n";
+#endif
+}
+
+//----------------------------------------------------------------------------
+
+bool ctkCmdLineApplication::saveProfile(const std::string& jsonFile) const
+{
+ std::ofstream file(jsonFile.c_str());
+ file << getProfileJSON();
+ return file.good();
+}
+
+//----------------------------------------------------------------------------
+
+void ctkCmdLineApplication::saveProfileAtExit()
+{
+#ifdef CTK_CLI_PROFILING
+ if (!mainInstance.saveProfile(mainInstance.profiling.outputFile))
+  std::cerr << "Failed to write " << mainInstance.profiling.outputFile << std::endl;
+#endif
+}
+
+//----------------------------------------------------------------------------
+
+// local utility to look up a tag without inserting it
+template <typename Map> const std::string& tagValue(const Map& tags, const std::string& key)
+{
+ static const std::string none;
+ typename Map::const_iterator it=tags.find(key);
+ return it==tags.end() ? none : it->second;
+}
+
+// local utility that formats the flags of an argument for the verbose help text or returns an empty string for none
+std::string optionVerbose(const ctkCLI::ctkParamDataInterface& p)
+{
+ const std::string& flag=tagValue(p.tags,"flag");
+ const std::string& longflag=tagValue(p.tags,"longflag");
+ if (flag.empty())
+ {
+  if (longflag.empty())
+   return std::string();
   else
-   str << " [--" << p.tags["longflag"] << " <" << p.getType() << ">]\n";
+   return " [--"+longflag+" <"+p.getType()+">]";
  }
  else
  {
-  if (p.tags["longflag"].empty())
-   str << " [-" << p.tags["flag"] << " <" << p.getType() << ">]\n";
+  if (longflag.empty())
+   return " [-"+flag+" <"+p.getType()+">]";
   else 
-   str << " [-" << p.tags["flag"] << "|--" << p.tags["longflag"] << " <" << p.getType() << ">]\n";
+   return " [-"+flag+"|--"+longflag+" <"+p.getType()+">]";
  }
- if (!p.tags["description"].empty())
-  str << "    " << p.tags["description"] << "\n\n";
 }
 
 //----------------------------------------------------------------------------
 
-std::string ctkCmdLineApplication::getSynopsis()
+std::string ctkCmdLineApplication::getSynopsis(bool aligned) const
 {
+ if (!synopsis[aligned].empty())
+  return synopsis[aligned];
+ CTK_PROFILE_PHASE(profiling,"getSynopsis");
 
  std::ostringstream str;
+ const std::string& titel=tagValue(tags,"titel");
  std::string indent="      ";
- for (int i=0;i<(int)tags["titel"].length();i++) indent.push_back(' ');
+ for (int i=0;i<(int)titel.length();i++) indent.push_back(' ');
  // Print short summary of cmd line args (std-args by ctk first)
  str << "USAGE:\n\n";
- str << "   " << "./" << tags["titel"] << " [-h] [--xml]\n";
- str << indent << "[--ctk-save-ini <file>] [--ctk-load-ini <file>]\n"; // 2do
+ str << "   " << "./" << titel << " [-h] [--xml]\n";
+ str << indent << "[--ctk-save-ini <file>] [--ctk-load-ini <file>] [--ctk-save-ini-delta <file>]\n"; // 2do
+ str << indent << "[--ctk-save-bin <file>] [--ctk-load-bin <file>]\n";
+ str << indent << "[--ctk-save-xml <file>]\n";
+ str << indent << "[--ctk-publish-shared <file>] [--ctk-attach-shared <file>]\n";
+ #ifdef CTK_CLI_PROFILING
+ str << indent << "[--ctk-profile <file>]\n";
+ #endif
+ if (batchCallback)
+  str << indent << "[--ctk-batch <file>] [--ctk-batch-threads <n>] [--ctk-serve <socket|->]\n";
  // All other cmd line args
- std::map<std::string, ctkCLI::ctkParamDataInterface*> indexed;
- for (MapIteratorStrStrParam sit=param.begin();sit!=param.end();++sit)
-  for (MapIteratorStrParam kit=sit->second.begin();kit!=sit->second.end();++kit)
+ const std::vector<int>& ids=registry.ordered();
+ for (IteratorId kit=ids.begin();kit!=ids.end();++kit)
   {
-   ctkCLI::ctkParamDataInterface& p(*(kit->second));
-   if (p.tags["flag"].empty() && p.tags["longflag"].empty())
-   {
-    if (p.tags["index"]!="")
-     indexed[p.tags["index"]]=&p;
-   }
+   const ctkCLI::ctkParamDataInterface& p(*registry[*kit].data);
+   const std::string& flag=tagValue(p.tags,"flag");
+   const std::string& longflag=tagValue(p.tags,"longflag");
+   if (flag.empty() && longflag.empty())
+    continue;
+   if (flag.empty())
+    str << indent << "[--" << longflag << " <" << p.getType() << ">]\n";
    else
-   {
-    if (p.tags["flag"].empty())
-     str << indent << "[--" << p.tags["longflag"] << " <" << p.getType() << ">]\n";
-    else
-     str << indent << "[-" << p.tags["flag"] << " <" << p.getType() << ">]\n";
-   }
+    str << indent << "[-" << flag << " <" << p.getType() << ">]\n";
   }
+ // Arguments by index, which have no flags
+ std::vector<const ctkCLI::ctkParamDataInterface*> indexed;
+ for (int i=0;i<registry.numIndexed();i++)
+ {
+  int id=registry.findIndexed(i);
+  if (id<0 || !registry[id].data) continue;
+  const ctkCLI::ctkParamDataInterface& p(*registry[id].data);
+  if (tagValue(p.tags,"flag").empty() && tagValue(p.tags,"longflag").empty() && !tagValue(p.tags,"index").empty())
+   indexed.push_back(&p);
+ }
  // finally print the index args
- for (MapIteratorStrParam it=indexed.begin();it!=indexed.end();++it)
-   str << indent << "<" << it->second->getType() << ">";
+ for (std::size_t i=0;i<indexed.size();i++)
+   str << indent << "<" << indexed[i]->getType() << ">";
+ // In aligned mode, descriptions start in the same column, unless the flags are very long
+ std::size_t column=0;
+ if (aligned)
+ {
+  for (IteratorId kit=ids.begin();kit!=ids.end();++kit)
+   column=std::max(column,optionVerbose(*registry[*kit].data).length());
+  column=std::min(column,(std::size_t)48)+3;
+ }
  // Go through the parameters again, by section, and print a verbose description
- for (MapIteratorStrStrParam sit=param.begin();sit!=param.end();++sit)
+ for (IteratorId kit=ids.begin();kit!=ids.end();)
  {
-  str << "\n\n" << sit->first << ":\n\n";
-  for (MapIteratorStrParam kit=sit->second.begin();kit!=sit->second.end();++kit)
-    printOptionVerbose(str,*(kit->second));
+  int section=registry[*kit].section;
+  str << "\n\n" << registry.getSection(*kit) << ":\n\n";
+  for (;kit!=ids.end() && registry[*kit].section==section;++kit)
+  {
+   const ctkCLI::ctkParamDataInterface& p(*registry[*kit].data);
+   std::string option=optionVerbose(p);
+   if (option.empty())
+    continue;
+   const std::string& description=tagValue(p.tags,"description");
+   if (!aligned)
+   {
+    str << option << "\n";
+    if (!description.empty())
+     str << "    " << description << "\n\n";
+   }
+   else if (description.empty())
+    str << option << "\n";
+   else if (option.length()<column)
+    str << option << std::string(column-option.length(),' ') << description << "\n";
+   else
+    str << option << "\n" << std::string(column,' ') << description << "\n";
+  }
  }
  // Also for teh indexed args
- for (MapIteratorStrParam it=indexed.begin();it!=indexed.end();++it)
+ for (std::size_t i=0;i<indexed.size();i++)
  {
-  str << "\n\n" << it->second->getType() << "(" << it->second->tags["index"] << "):\n";
-  str << "    " << it->second->tags["description"] << "\n";
+  str << "\n\n" << indexed[i]->getType() << "(" << tagValue(indexed[i]->tags,"index") << "):\n";
+  str << "    " << tagValue(indexed[i]->tags,"description") << "\n";
  }
  // Finally print the description, contributors and acknowledgements for the tool
- if (!tags["description"].empty())
-  str << "\n\n" << tags["description"] << "\n\n";
- if (!tags["contributor"].empty())
-  str << "\n\nAuthor: " << tags["contributor"] << "\n\n";
- if (!tags["acknowledgements"].empty())
-  str << "\n\nAcknowledgements: " << tags["acknowledgements"] << "\n\n";
- return str.str();
+ if (!tagValue(tags,"description").empty())
+  str << "\n\n" << tagValue(tags,"description") << "\n\n";
+ if (!tagValue(tags,"contributor").empty())
+  str << "\n\nAuthor: " << tagValue(tags,"contributor") << "\n\n";
+ if (!tagValue(tags,"acknowledgements").empty())
+  str << "\n\nAcknowledgements: " << tagValue(tags,"acknowledgements") << "\n\n";
+ synopsis[aligned]=str.str();
+ return synopsis[aligned];
 }
 
 #endif // __ctkCmdLineApplication_h
@@ -78,60 +78,73 @@
 template <typename BasicType>
 class ctkParam {
 protected:
- std::string section;
- std::string key;
  ctkCmdLineApplication& app;
+ /// Id of the parameter within the app, which holds its section and key
+ int id;
+ /// The value converted from a parameter of another c++ type (see getValue)
+ mutable BasicType converted;
 
  /// c-tor called by sub-classes: declare type will not be used, because it is not an exact type match
- ctkParam() : app(ctkApp) {}
+ ctkParam(ctkCmdLineApplication& a) : app(a), id(-1), converted() {}
 
  std::string getNormName() const
  {
-  std::string name=section+"-"+key;
-  std::transform(name.begin(), name.end(), name.begin(), ::tolower);
-  std::replace(name.begin(), name.end(),' ','-');
-  return name;
+  return std::string(app.getParamName(id));
+ }
+
+ /// Access to the parameter to change its tags, attribs or constraints. Invalidates the cached descriptions of the app.
+ ctkCLI::ctkParamDataInterface& schema()
+ {
+  app.schemaChanged(id);
+  return *app.getParam(id);
  }
 
 public:
  /// Define a parameter with this constructor. Do not use new. This class is a temporary proxy and does not store the value.
- ctkParam(const std::string& s, const std::string k)
-  : app(ctkApp) , section(s) , key(k)
+ ctkParam(std::string_view section, std::string_view key) : ctkParam(ctkApp,section,key) {}
+
+ /// Define a parameter of a ctkCmdLineApplication other than the default of the current thread (see ctkApp)
+ ctkParam(ctkCmdLineApplication& a, std::string_view section, std::string_view key)
+  : app(a), id(app.addParamId(section,key)), converted()
  {
-  if (!app.getParam(section,key))
+  CTK_PROFILE_PHASE(app.getProfile(),"declare");
+  if (!app.getParam(id))
    declareType();
-  app.getParam(section,key)->tags["name"]=getNormName();
+  // (only a change of the name affects the cached descriptions of the app)
+  if (app.getParam(id)->tags["name"].empty())
+   schema().tags["name"]=getNormName();
  }
  
  /// Provide a (verbose) description of what this parameter is good for.
  ctkParam& setDescription(const std::string& str) {
-  app.getParam(section,key)->tags["description"]=str;
+  schema().tags["description"]=str;
   return *this;
  }
 
  /// Provide a label to this parameter
  ctkParam& setLabel(const std::string& str) {
-  app.getParam(section,key)->tags["label"]=str;
+  schema().tags["label"]=str;
   return *this;
  }
 
  ctkParam& setChannel(bool input)
  {
-  app.getParam(section,key)->tags["channel"]=( input ? "input" : "output" );
+  schema().tags["channel"]=( input ? "input" : "output" );
   return *this;
  }
 
  /// Declare a flag for this parameter (shortflag should be single character string or empty)
  ctkParam& declare(const std::string& description, const std::string& shortflag="")
  {
+  CTK_PROFILE_PHASE(app.getProfile(),"declare");
   std::string name=getNormName();
-  app.getParam(section,key)->tags["longflag"]=name;
-  app.setFlag(std::string("--")+name,section,key);
-  app.getParam(section,key)->tags["description"]=description;
+  schema().tags["longflag"]=name;
+  app.setFlag(std::string("--")+name,id);
+  schema().tags["description"]=description;
   if (!shortflag.empty())
   {
-   app.setFlag(std::string("-")+shortflag,section,key);
-   app.getParam(section,key)->tags["flag"]=shortflag;
+   app.setFlag(std::string("-")+shortflag,id);
+   schema().tags["flag"]=shortflag;
   }
   return *this;
  }
@@ -139,75 +152,280 @@ public:
  // Declare Indexed Command Line Argument
  ctkParam& declare(const std::string& description, int idx)
  {
-  app.getParam(section,key)->tags["flag"]=app.getParam(section,key)->tags["longflag"];
-  app.getParam(section,key)->tags["index"]=ctkCLI::toString(idx);
-  app.setFlag(ctkCLI::toString(idx),section,key);
-  app.getParam(section,key)->tags["description"]=description;
+  std::string longflag=schema().tags["longflag"];
+  schema().tags["flag"]=longflag;
+  schema().tags["index"]=ctkCLI::toString(idx);
+  app.setFlag(ctkCLI::toString(idx),id);
+  schema().tags["description"]=description;
   return *this;
  }
 
- virtual std::string getString() const { return app.getParam(section,key)->getString(); }
- virtual void setString(const std::string& value) { return app.getParam(section,key)->setString(value); }
+ /// Convert values set through strings (command line, ini-files) only on first access, eg. for large vectors, which may never be used.
+ /// getString() then returns the original text.
+ ctkParam& setLazy(bool lazy=true) {
+  app.getParam(id)->lazy=lazy;
+  return *this;
+ }
 
- /// Force the ctkParamData to convert its type. (a ctkParam of type double can be used to get/set int data, no conversion will happen)
+ virtual std::string getString() const { return app.getParam(id)->getString(); }
+ virtual bool setString(std::string_view value) {
+  app.willChange(id);
+  bool ok=app.getParam(id)->setString(value);
+  app.notifyChanges();
+  return ok;
+ }
+
+ /// Force the ctkParamData to convert its type. (a ctkParam of type double can be used to get/set int data, converted directly without strings)
  void declareType() {
-  app.setParam(section,key,new ctkCLI::ctkParamData<BasicType>());
+  app.setParam(id,new ctkCLI::ctkParamData<BasicType>());
   declare("",""); // makes the long flag known
  }
 
  /// Assignment by template type. Makes the ctkParam behave almost like a c++ variable of the template type
  inline ctkParam& operator=(const BasicType& v) { return setValue(v); }
+ inline ctkParam& operator=(BasicType&& v) { return setValue(std::move(v)); }
  /// Cast to template type. Makes the ctkParam behave almost like a c++ variable of the template type
- inline operator BasicType() const { return getValue(); }
+ inline operator const BasicType&() const { return getValue(); }
 
- /// Access to value (alternative to type-cast operator)
- BasicType getValue() const {
-  ctkCLI::ctkParamDataInterface* p=app.getParam(section,key);
-  ctkCLI::ctkParamData<BasicType>* sameType=dynamic_cast<ctkCLI::ctkParamData<BasicType>*>(p);
-  if (sameType) return sameType->value;
-  else return ctkCLI::stringTo<BasicType>(p->getString());
+ /// Access to value (alternative to type-cast operator). Refers to the value of the parameter itself, if it is of type
+ /// BasicType, and stays valid until it is set. Else it refers to a converted copy, which lives as long as this proxy.
+ const BasicType& getValue() const {
+  CTK_PROFILE_ACCESS(app.getProfile(),id);
+  const ctkCLI::ctkParamDataInterface* p=app.getParam(id);
+  const ctkCLI::ctkParamValue<BasicType>* same=ctkCLI::valueOf<BasicType>(p);
+  if (same) return same->get();
+  converted=ctkCLI::getValueAs<BasicType>(p);
+  return converted;
  }
 
  /// Set the value (alternative to the overloaded assignment operator)
  ctkParam& setValue(const BasicType& in) {
-  ctkCLI::ctkParamDataInterface* p=app.getParam(section,key);
-  ctkCLI::ctkParamData<BasicType>* sameType=dynamic_cast<ctkCLI::ctkParamData<BasicType>*>(p);
-  if (sameType) sameType->value=in;
-  else p->setString(ctkCLI::toString(in));
+  app.willChange(id);
+  ctkCLI::setValueAs(app.getParam(id),in);
+  app.notifyChanges();
+  return *this;
+ }
+
+ /// Set the value, which is moved into a parameter of type BasicType without copies (eg. large vectors)
+ ctkParam& setValue(BasicType&& in) {
+  app.willChange(id);
+  ctkCLI::ctkParamDataInterface* p=app.getParam(id);
+  ctkCLI::ctkParamValue<BasicType>* same=ctkCLI::valueOf<BasicType>(p);
+  if (same) same->set(std::move(in));
+  else ctkCLI::setValueAs(p,in);
+  app.notifyChanges();
+  return *this;
+ }
+
+};
+
+/**
+* \ingroup Command Line Module
+*
+* A bound handle to a parameter for repeated access, eg. in tight loops.
+*
+* ctkParam looks up its section/key pair on every access. ctkParamRef
+* resolves the parameter once and keeps a pointer to its ctkParamData.
+* If the parameter is replaced via ctkCmdLineApplication::setParam
+* (eg. by declaring a special type), the handle re-binds on next access.
+* Replacements are recognized by the generation of the parameter rather
+* than its address, since the new one may well live at the old address.
+*
+* Unlike ctkParam, a ctkParamRef may well be stored, as long as the application lives.
+*
+* Syntax example:<br>
+*   ctkParamRef<int> maxIter("Algorithm", "Max Iteration");<br>
+*   for (int i=0;i<maxIter;i++) ...<br>
+**/
+template <typename BasicType>
+class ctkParamRef {
+ ctkCmdLineApplication& app;
+ /// Id of the parameter within the ctkCmdLineApplication
+ int id;
+ /// The generation of the parameter the handle has been bound to (see ctkCmdLineApplication::getParamGeneration)
+ mutable unsigned int generation;
+ /// The parameter, if it holds a value of type BasicType
+ mutable ctkCLI::ctkParamValue<BasicType>* sameType;
+ /// The value converted from a parameter of another c++ type (see getValue)
+ mutable BasicType converted;
+
+ /// Resolve the exact type of the parameter (happens once and whenever it is replaced)
+ void bind() const
+ {
+  generation=app.getParamGeneration(id);
+  sameType=ctkCLI::valueOf<BasicType>(app.getParam(id));
+ }
+
+public:
+ /// Bind to the parameter by section/key pair. It is declared with type BasicType, if it does not exist yet.
+ ctkParamRef(std::string_view section, std::string_view key) : ctkParamRef(ctkApp,section,key) {}
+
+ /// Bind to a parameter of a ctkCmdLineApplication other than the default of the current thread (see ctkApp)
+ ctkParamRef(ctkCmdLineApplication& a, std::string_view section, std::string_view key)
+  : app(a), id(-1), generation(0), sameType(0x0), converted()
+ {
+  ctkParam<BasicType>(app,section,key);
+  id=app.getParamId(section,key);
+  bind();
+ }
+
+ /// Assignment by template type. Makes the ctkParamRef behave almost like a c++ variable of the template type
+ inline ctkParamRef& operator=(const BasicType& v) { return setValue(v); }
+ inline ctkParamRef& operator=(BasicType&& v) { return setValue(std::move(v)); }
+ /// Cast to template type. Makes the ctkParamRef behave almost like a c++ variable of the template type
+ inline operator const BasicType&() const { return getValue(); }
+
+ /// Access to value (alternative to type-cast operator), without copies for parameters of type BasicType (see ctkParam::getValue).
+ /// Values of other types are converted into a copy held by this handle.
+ inline const BasicType& getValue() const {
+  CTK_PROFILE_ACCESS(app.getProfile(),id);
+  if (app.getParamGeneration(id)!=generation) bind();
+  if (sameType) return sameType->get();
+  converted=ctkCLI::getValueAs<BasicType>(app.getParam(id));
+  return converted;
+ }
+
+ /// The value in the snapshot last published by the app (see ctkCmdLineApplication::publish). Safe to call from any thread.
+ /// Value-initialized, if the parameter was not published as type BasicType.
+ BasicType getPublished() const {
+  BasicType value=BasicType();
+  app.published()->get(id,value);
+  return value;
+ }
+
+ /// Set the value (alternative to the overloaded assignment operator)
+ inline ctkParamRef& setValue(const BasicType& in) {
+  if (app.getParamGeneration(id)!=generation) bind();
+  app.willChange(id);
+  if (sameType) sameType->set(in);
+  else ctkCLI::setValueAs(app.getParam(id),in);
+  app.notifyChanges();
+  return *this;
+ }
+
+ /// Set the value, which is moved into a parameter of type BasicType without copies
+ inline ctkParamRef& setValue(BasicType&& in) {
+  if (app.getParamGeneration(id)!=generation) bind();
+  app.willChange(id);
+  if (sameType) sameType->set(std::move(in));
+  else ctkCLI::setValueAs(app.getParam(id),in);
+  app.notifyChanges();
   return *this;
  }
 
 };
 
+/**
+* \ingroup Command Line Module
+*
+* Binds the fields of a user struct to the keys of one section, so that
+* algorithm code can read all its parameters in one call and then use
+* plain struct fields in hot loops.
+*
+* Each field is resolved to its parameter once, when it is bound. fill()
+* then copies all values into the struct in a single pass by parameter id,
+* without any lookup by section/key. Values of other, compatible types are
+* converted as by ctkParam (see ctkCLI::getValueAs).
+*
+* Syntax example:<br>
+*   struct Algorithm { int maxIter; double step; };<br>
+*   ctkParamBinding<Algorithm> binding("Algorithm");<br>
+*   binding.bind("Max Iteration",&Algorithm::maxIter).bind("Step",&Algorithm::step);<br>
+*   Algorithm algorithm;<br>
+*   binding.fill(algorithm); // eg. at the start of every iteration<br>
+**/
+template <typename Struct>
+class ctkParamBinding {
+ struct Field
+ {
+  int id;
+  std::function<void(const ctkCLI::ctkParamDataInterface*, Struct&)> read;
+  std::function<void(ctkCLI::ctkParamDataInterface*, const Struct&)> write;
+  bool operator<(const Field& other) const { return id<other.id; }
+ };
+
+ ctkCmdLineApplication& app;
+ std::string section;
+ /// Sorted by id, so that fill visits the parameters in the order of the registry
+ std::vector<Field> fields;
+
+public:
+ /// Bind fields to keys of section
+ ctkParamBinding(std::string_view s) : app(ctkApp), section(s) {}
+ /// Bind fields to keys of section of a ctkCmdLineApplication other than the default of the current thread (see ctkApp)
+ ctkParamBinding(ctkCmdLineApplication& a, std::string_view s) : app(a), section(s) {}
+
+ /// Bind a field to a key of the section. The parameter is declared with type T, if it does not exist yet.
+ template <typename T> ctkParamBinding& bind(std::string_view key, T Struct::*member)
+ {
+  ctkParam<T>(app,section,key);
+  Field field;
+  field.id=app.getParamId(section,key);
+  field.read=[member](const ctkCLI::ctkParamDataInterface* p, Struct& s) { s.*member=ctkCLI::getValueAs<T>(p); };
+  field.write=[member](ctkCLI::ctkParamDataInterface* p, const Struct& s) { ctkCLI::setValueAs(p,s.*member); };
+  fields.insert(std::upper_bound(fields.begin(),fields.end(),field),field);
+  return *this;
+ }
+
+ /// Copy the values of all bound parameters into the fields of s
+ void fill(Struct& s) const
+ {
+  for (std::size_t i=0;i<fields.size();i++)
+  {
+   CTK_PROFILE_ACCESS(app.getProfile(),fields[i].id);
+   fields[i].read(app.getParam(fields[i].id),s);
+  }
+ }
+
+ /// A struct with the values of all bound parameters. Fields which are not bound are value-initialized.
+ Struct get() const
+ {
+  Struct s=Struct();
+  fill(s);
+  return s;
+ }
+
+ /// Set all bound parameters from the fields of s
+ void store(const Struct& s)
+ {
+  // observers are notified once for all fields
+  app.beginChanges();
+  for (std::size_t i=0;i<fields.size();i++)
+  {
+   app.willChange(fields[i].id);
+   fields[i].write(app.getParam(fields[i].id),s);
+  }
+  app.endChanges();
+ }
+};
+
 // Some ugly preprocessor code, which makes the definitions in this file a lot shorter.
-#define CTK_PARAM_DEFINE_ATTRIB(ATTRIB,FUNCNAME) ThisType& set##FUNCNAME(const std::string& str) { app.getParam(section,key)->attribs[ATTRIB]=str; return *this;}
-#define CTK_PARAM_DEFINE_TAG(ATTRIB,FUNCNAME) ThisType& set##FUNCNAME(const std::string& str) { app.getParam(section,key)->tags[ATTRIB]=str; return *this;}
+#define CTK_PARAM_DEFINE_ATTRIB(ATTRIB,FUNCNAME) ThisType& set##FUNCNAME(const std::string& str) { schema().attribs[ATTRIB]=str; return *this;}
+#define CTK_PARAM_DEFINE_TAG(ATTRIB,FUNCNAME) ThisType& set##FUNCNAME(const std::string& str) { schema().tags[ATTRIB]=str; return *this;}
 
 #define DEFINE_TYPE_SPECIALIZATION(TYPE,BASE,TYPESTR,SPECIAL)                  \
  namespace ctkCLI {                                                         \
-  class ctkParamData##TYPE : public ctkParamDataInterface {              \
+  class ctkParamData##TYPE : public ctkParamValue<BASE> {               \
   public:                                                                \
-   BASE value;                                                        \
    virtual std::string getType() const { return TYPESTR; }            \
-   virtual std::string getString() const { return toString(value); }  \
-   virtual void        setString(const std::string& new_value) {      \
-    value=stringTo<BASE>(new_value);                               \
-   }                                                                  \
   };                                                                     \
  }                                                                          \
 class ctkParam##TYPE : public ctkParam<BASE> {                                 \
  typedef ctkParam##TYPE ThisType;                                           \
  public:                                                                    \
-  ctkParam##TYPE(const std::string& s, const std::string& k)             \
-  : ctkParam<BASE>() {                                                   \
-   section=s; key=k;                                                  \
-   if (!app.getParam(section,key))                                    \
+  ctkParam##TYPE(std::string_view s, std::string_view k)                 \
+  : ctkParam##TYPE(ctkApp,s,k) {}                                       \
+  ctkParam##TYPE(ctkCmdLineApplication& a, std::string_view s, std::string_view k) \
+  : ctkParam<BASE>(a) {                                                  \
+   id=app.addParamId(s,k);                                            \
+   if (!app.getParam(id))                                             \
     declareType();                                                 \
   }                                                                      \
   ctkParam<BASE>& operator=(const BASE& v) { return setValue(v); }             \
-  operator BASE() const { return getValue(); }                           \
+  ctkParam<BASE>& operator=(BASE&& v) { return setValue(std::move(v)); }       \
+  operator const BASE&() const { return getValue(); }                    \
   void declareType() {                                                   \
-   app.setParam(section,key,new ctkCLI::ctkParamData##TYPE());        \
+   app.setParam(id,new ctkCLI::ctkParamData##TYPE());                 \
    declare("","");                                                    \
   }                                                                      \
   SPECIAL                                                                \
@@ -226,16 +444,17 @@ DEFINE_TYPE_SPECIALIZATION(File,std::string,"file",CTK_PARAM_DEFINE_ATTRIB("file
 DEFINE_TYPE_SPECIALIZATION(Directory,std::string,"directory", )
 DEFINE_TYPE_SPECIALIZATION(Image,std::string,"image",CTK_PARAM_DEFINE_ATTRIB("type",Type) CTK_PARAM_DEFINE_ATTRIB("fileExtensions",FileExtensions) )
 DEFINE_TYPE_SPECIALIZATION(Geometry,std::string,"geometry",CTK_PARAM_DEFINE_ATTRIB("type",Type) CTK_PARAM_DEFINE_ATTRIB("fileExtensions",FileExtensions) )
-DEFINE_TYPE_SPECIALIZATION(Point,std::vector<std::string>,"point",CTK_PARAM_DEFINE_ATTRIB("multiple",Multiple) CTK_PARAM_DEFINE_ATTRIB("coordinateSystem",CoordinateSystem) )
-DEFINE_TYPE_SPECIALIZATION(Region,std::vector<std::string>,"region",CTK_PARAM_DEFINE_ATTRIB("multiple",Multiple) CTK_PARAM_DEFINE_ATTRIB("coordinateSystem",CoordinateSystem) )
+// Coordinates of points and regions are stored as packed floats, the coordinateSystem is an attribute of its own
+DEFINE_TYPE_SPECIALIZATION(Point,std::vector<float>,"point",CTK_PARAM_DEFINE_ATTRIB("multiple",Multiple) CTK_PARAM_DEFINE_ATTRIB("coordinateSystem",CoordinateSystem) )
+DEFINE_TYPE_SPECIALIZATION(Region,std::vector<float>,"region",CTK_PARAM_DEFINE_ATTRIB("multiple",Multiple) CTK_PARAM_DEFINE_ATTRIB("coordinateSystem",CoordinateSystem) )
 
 //----------------------------------------------------------------------------
 // For double: Slider range (should be a template specialization of ctkParam<double> really)
 DEFINE_TYPE_SPECIALIZATION(Double,std::string,"double", 
  ctkParamDouble& setRange(double minv, double maxv, double step=0.01) {
-   app.getParam(section,key)->constraints["minimum"]=ctkCLI::toString(minv);
-   app.getParam(section,key)->constraints["maximum"]=ctkCLI::toString(maxv);
-   app.getParam(section,key)->constraints["step"]=ctkCLI::toString(step);
+   schema().constraints["minimum"]=ctkCLI::toString(minv);
+   schema().constraints["maximum"]=ctkCLI::toString(maxv);
+   schema().constraints["step"]=ctkCLI::toString(step);
    return *this;
   }
  );
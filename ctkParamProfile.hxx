@@ -0,0 +1,190 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) Lehrstuhl fuer Mustererkennung,
+    Universitaet Erlangen-Nuernberg
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#ifndef __ctkParamProfile_h
+#define __ctkParamProfile_h
+
+/**
+ * Optional instrumentation of the parameter handling.
+ *
+ * Define CTK_CLI_PROFILING before including any ctk header (eg. -DCTK_CLI_PROFILING)
+ * to record wall time, heap allocations and bytes per phase (declaration, parsing,
+ * xml etc.), the number of parameter lookups and string conversions and the number
+ * of accesses to each parameter. Without it, all instrumentation compiles to nothing.
+ * Phases and accesses are recorded per ctkCmdLineApplication (see getProfile()), the
+ * allocations of a phase in the thread running it. Lookups and conversions are counted
+ * for the whole process.
+ * See ctkCmdLineApplication::getProfileJSON() and --ctk-profile <file>.
+ *
+ * Heap allocations are counted by replacing the global operator new/delete (see
+ * CTK_PROFILE_DEFINE_ALLOCATION_HOOKS). Programs which replace them themselves define
+ * CTK_CLI_PROFILING_NO_ALLOC_HOOKS.
+ **/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace ctkCLI {
+
+ /// Counters of all threads. Constant-initialized, so that allocations can be counted before anything else is constructed.
+ struct ctkProfileCounters
+ {
+  /// Heap allocations and their bytes in total and in use (counted by CTK_PROFILE_DEFINE_ALLOCATION_HOOKS)
+  static inline std::atomic<std::uint64_t> allocations{0};
+  static inline std::atomic<std::uint64_t> bytes{0};
+  static inline std::atomic<std::uint64_t> bytesInUse{0};
+  /// Heap allocations and their bytes of the current thread, so that phases of different threads are told apart
+  static inline thread_local std::uint64_t threadAllocations=0;
+  static inline thread_local std::uint64_t threadBytes=0;
+  /// Lookups of parameters by section/key, name or flag
+  static inline std::atomic<std::uint64_t> lookups{0};
+  /// Conversions of values from and to strings
+  static inline std::atomic<std::uint64_t> conversions{0};
+  /// Each allocation is prefixed by its size, so that bytesInUse can be counted down
+  static constexpr std::size_t allocationPrefix=alignof(std::max_align_t);
+ };
+
+} // namespace ctkCLI
+
+/// Replaces the global operator new/delete to count allocations in ctkProfileCounters. Expanded once per program:
+/// by CTK_INSTANTIATE_CMD_LINE_APP with CTK_CLI_PROFILING, unless CTK_CLI_PROFILING_NO_ALLOC_HOOKS is defined,
+/// eg. by programs which expand it themselves (such as the benchmark) or replace the global allocator otherwise.
+#define CTK_PROFILE_DEFINE_ALLOCATION_HOOKS                                                              \
+ void* operator new(std::size_t n)                                                                      \
+ {                                                                                                      \
+  char* p=static_cast<char*>(std::malloc(n+ctkCLI::ctkProfileCounters::allocationPrefix));            \
+  if (!p) throw std::bad_alloc();                                                                      \
+  *reinterpret_cast<std::size_t*>(p)=n;                                                                \
+  ctkCLI::ctkProfileCounters::allocations.fetch_add(1,std::memory_order_relaxed);                     \
+  ctkCLI::ctkProfileCounters::bytes.fetch_add(n,std::memory_order_relaxed);                           \
+  ctkCLI::ctkProfileCounters::bytesInUse.fetch_add(n,std::memory_order_relaxed);                      \
+  ctkCLI::ctkProfileCounters::threadAllocations++;                                                     \
+  ctkCLI::ctkProfileCounters::threadBytes+=n;                                                          \
+  return p+ctkCLI::ctkProfileCounters::allocationPrefix;                                               \
+ }                                                                                                      \
+ void operator delete(void* p) noexcept                                                                 \
+ {                                                                                                      \
+  if (!p) return;                                                                                      \
+  char* block=static_cast<char*>(p)-ctkCLI::ctkProfileCounters::allocationPrefix;                     \
+  ctkCLI::ctkProfileCounters::bytesInUse.fetch_sub(*reinterpret_cast<std::size_t*>(block),std::memory_order_relaxed); \
+  std::free(block);                                                                                    \
+ }                                                                                                      \
+ void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+
+#ifdef CTK_CLI_PROFILING
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ctkCLI {
+
+ /// Totals of one phase of the parameter handling. Nested calls of the same phase count once.
+ struct ctkProfilePhase
+ {
+  std::uint64_t calls;
+  std::uint64_t ns;
+  std::uint64_t allocations;
+  std::uint64_t bytes;
+  int depth;
+  ctkProfilePhase() : calls(0), ns(0), allocations(0), bytes(0), depth(0) {}
+ };
+
+ /// The measurements of one ctkCmdLineApplication, except for the counters. Used by the thread using the application only.
+ struct ctkProfile
+ {
+  /// Phases by name
+  std::map<std::string,ctkProfilePhase> phases;
+  /// Accesses to the value of each parameter by id
+  std::vector<std::uint64_t> accesses;
+  /// Where to save the profile on exit (see --ctk-profile)
+  std::string outputFile;
+
+  void access(int id)
+  {
+   if (id<0) return;
+   if (id>=(int)accesses.size()) accesses.resize(id+1,0);
+   accesses[id]++;
+  }
+ };
+
+ /// Measures a phase during its lifetime
+ class ctkProfileScope
+ {
+  ctkProfilePhase& phase;
+  std::chrono::steady_clock::time_point start;
+  std::uint64_t allocations, bytes;
+
+  ctkProfileScope(const ctkProfileScope&);
+  ctkProfileScope& operator=(const ctkProfileScope&);
+
+ public:
+  ctkProfileScope(ctkProfile& profile, const char* name) : phase(profile.phases[name])
+  {
+   if (phase.depth++>0) return;
+   allocations=ctkProfileCounters::threadAllocations;
+   bytes=ctkProfileCounters::threadBytes;
+   start=std::chrono::steady_clock::now();
+  }
+
+  ~ctkProfileScope()
+  {
+   if (--phase.depth>0) return;
+   phase.calls++;
+   phase.ns+=(std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count();
+   phase.allocations+=ctkProfileCounters::threadAllocations-allocations;
+   phase.bytes+=ctkProfileCounters::threadBytes-bytes;
+  }
+ };
+
+} // namespace ctkCLI
+
+#define CTK_PROFILE_CONCAT_IMPL(A,B) A##B
+#define CTK_PROFILE_CONCAT(A,B) CTK_PROFILE_CONCAT_IMPL(A,B)
+/// Measure the enclosing scope as phase NAME of PROFILE (a ctkProfile, see ctkCmdLineApplication::getProfile)
+#define CTK_PROFILE_PHASE(PROFILE,NAME) ctkCLI::ctkProfileScope CTK_PROFILE_CONCAT(ctkProfileScope,__LINE__)(PROFILE,NAME)
+#define CTK_PROFILE_LOOKUP() (ctkCLI::ctkProfileCounters::lookups.fetch_add(1,std::memory_order_relaxed))
+#define CTK_PROFILE_CONVERSION() (ctkCLI::ctkProfileCounters::conversions.fetch_add(1,std::memory_order_relaxed))
+#define CTK_PROFILE_ACCESS(PROFILE,ID) ((PROFILE).access(ID))
+
+/// The allocation hooks CTK_INSTANTIATE_CMD_LINE_APP defines
+#ifndef CTK_CLI_PROFILING_NO_ALLOC_HOOKS
+#define CTK_PROFILE_INSTANTIATE_ALLOCATION_HOOKS CTK_PROFILE_DEFINE_ALLOCATION_HOOKS
+#else
+#define CTK_PROFILE_INSTANTIATE_ALLOCATION_HOOKS
+#endif
+
+#else // CTK_CLI_PROFILING
+
+#define CTK_PROFILE_PHASE(PROFILE,NAME)
+#define CTK_PROFILE_LOOKUP() ((void)0)
+#define CTK_PROFILE_CONVERSION() ((void)0)
+#define CTK_PROFILE_ACCESS(PROFILE,ID) ((void)0)
+#define CTK_PROFILE_INSTANTIATE_ALLOCATION_HOOKS
+
+#endif // CTK_CLI_PROFILING
+
+#endif // __ctkParamProfile_h
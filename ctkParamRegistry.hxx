@@ -0,0 +1,320 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) Lehrstuhl fuer Mustererkennung,
+    Universitaet Erlangen-Nuernberg
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#ifndef __ctkParamRegistry_h
+#define __ctkParamRegistry_h
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "ctkParamProfile.hxx"
+#include "ctkParamStorage.hxx"
+
+namespace ctkCLI {
+
+ class ctkParamDataInterface;
+
+ /// A character of a normalized parameter name: lower case and '-' instead of ' ' (independent of the locale, thus usable at compile time)
+ constexpr char normChar(char c) { return c==' ' ? '-' : (c>='A' && c<='Z' ? (char)(c-'A'+'a') : c); }
+
+ /// The normalized name of a parameter, as used for command line flags. Eg. "Basic Types","Bool Param" -> "basic-types-bool-param"
+ inline std::string normName(std::string_view section, std::string_view key)
+ {
+  std::string name;
+  name.reserve(section.length()+key.length()+1);
+  name.append(section).append(1,'-').append(key);
+  std::transform(name.begin(), name.end(), name.begin(), normChar);
+  return name;
+ }
+
+ /// FNV-1a hash of a string, continued from a previous hash value h.
+ constexpr std::size_t hashString(const char* str, std::size_t len, std::size_t h=2166136261u)
+ {
+  for (std::size_t i=0;i<len;i++)
+   h=(h^(unsigned char)str[i])*16777619u;
+  return h;
+ }
+
+ /// The hash of normName(section,key), computed without building the name
+ constexpr std::size_t hashNormName(std::string_view section, std::string_view key)
+ {
+  std::size_t h=2166136261u;
+  for (std::size_t i=0;i<section.length();i++) h=(h^(unsigned char)normChar(section[i]))*16777619u;
+  h=(h^(unsigned char)'-')*16777619u;
+  for (std::size_t i=0;i<key.length();i++) h=(h^(unsigned char)normChar(key[i]))*16777619u;
+  return h;
+ }
+
+ /**
+  * \ingroup Command Line Module
+  *
+  * Open addressing hash index from precomputed hash values to integer ids.
+  *
+  * The index itself does not know the keys. Lookups take a predicate
+  * which compares a candidate id against the key searched for.
+  **/
+ class ctkHashIndex
+ {
+  /// Pairs of hash and id. An id of -1 marks an empty slot. Size is always a power of two.
+  std::vector<std::pair<std::size_t,int> > slots;
+  int count;
+
+  void grow()
+  {
+   std::vector<std::pair<std::size_t,int> > old(slots.empty() ? 16 : slots.size()*2, std::make_pair(std::size_t(0),-1));
+   old.swap(slots);
+   count=0;
+   for (std::size_t i=0;i<old.size();i++)
+    if (old[i].second>=0)
+     insert(old[i].first,old[i].second);
+  }
+
+ public:
+  ctkHashIndex() : count(0) {}
+
+  /// Returns the first id with hash value h for which eq(id) holds or -1.
+  template <typename Predicate> int find(std::size_t h, Predicate eq) const
+  {
+   if (slots.empty()) return -1;
+   std::size_t mask=slots.size()-1;
+   for (std::size_t i=h&mask;slots[i].second>=0;i=(i+1)&mask)
+    if (slots[i].first==h && eq(slots[i].second))
+     return slots[i].second;
+   return -1;
+  }
+
+  /// Add an id with hash value h. Does not check for duplicates.
+  void insert(std::size_t h, int id)
+  {
+   if (2*(count+1)>(int)slots.size()) grow();
+   std::size_t mask=slots.size()-1;
+   std::size_t i=h&mask;
+   while (slots[i].second>=0) i=(i+1)&mask;
+   slots[i]=std::make_pair(h,id);
+   count++;
+  }
+ };
+
+ /// Storage of one parameter within a ctkParamRegistry
+ struct ctkParamRecord
+ {
+  /// Interned id of the section
+  int section;
+  /// The key within the section (held by the ctkParamRegistry)
+  std::string_view key;
+  /// The normalized name (see normName, held by the ctkParamRegistry)
+  std::string_view name;
+  /// The actual parameter. Owned by the ctkCmdLineApplication.
+  ctkParamDataInterface* data;
+  /// Incremented whenever data is replaced. A new parameter may be allocated at the address of the old one,
+  /// so handles which keep a pointer to data compare the generation rather than the pointer (see ctkParamRef).
+  unsigned int generation;
+ };
+
+ /**
+  * \ingroup Command Line Module
+  *
+  * Flat storage of the parameters of a ctkCmdLineApplication.
+  *
+  * All parameters are held in one contiguous array of ctkParamRecords and
+  * are referenced by their index into this array, which never changes.
+  * Section names are interned, records are found through a hash index on
+  * their normalized names. Command line flags map to record ids directly.
+  * The strings of all records are stored in one ctkArena.
+  **/
+ class ctkParamRegistry
+ {
+  std::vector<ctkParamRecord> records;
+  /// Keys and names of the records and the command line flags
+  ctkArena strings;
+  /// Interned section names
+  std::vector<std::string> sections;
+  /// Record ids by normalized name. Several records may share a normalized name, thus lookups compare section/key.
+  ctkHashIndex recordIndex;
+  /// Section ids by name
+  ctkHashIndex sectionIndex;
+  /// Command line flags (eg. "--section-key", "-k" or "0" for indexed parameters) and the associated record id
+  std::vector<std::pair<std::string_view,int> > flags;
+  ctkHashIndex flagIndex;
+  /// Record ids of indexed parameters by index or -1
+  std::vector<int> indexed;
+  /// Ids of records with data sorted by section and key. Rebuilt on demand after insertions.
+  mutable std::vector<int> order;
+  mutable bool orderValid;
+
+  int findSection(std::string_view section) const
+  {
+   return sectionIndex.find(hashString(section.data(),section.length()),
+    [&](int sid) { return sections[sid]==section; });
+  }
+
+ public:
+  ctkParamRegistry() : orderValid(true) {}
+
+  /// Number of parameters
+  int size() const { return (int)records.size(); }
+
+  /// Access a record by its id
+  ctkParamRecord& operator[](int id) { return records[id]; }
+  const ctkParamRecord& operator[](int id) const { return records[id]; }
+
+  /// Name of the section of a record
+  const std::string& getSection(int id) const { return sections[records[id].section]; }
+
+  /// Id of the record by section/key pair or -1 if unknown
+  int find(std::string_view section, std::string_view key) const
+  {
+   CTK_PROFILE_LOOKUP();
+   return recordIndex.find(hashNormName(section,key),
+    [&](int id) { return records[id].key==key && sections[records[id].section]==section; });
+  }
+
+  /// Id of a record by its normalized name or -1 if unknown. If the name is ambiguous, the first declared record is returned.
+  int findName(std::string_view name) const
+  {
+   CTK_PROFILE_LOOKUP();
+   return recordIndex.find(hashString(name.data(),name.length()),
+    [&](int id) { return records[id].name==name; });
+  }
+
+  /// Id of the record by section/key pair. A new record without data is added, if it does not exist yet (see setData).
+  int insert(std::string_view section, std::string_view key)
+  {
+   // the name is only built for new records
+   int id=find(section,key);
+   return id>=0 ? id : insert(section,key,normName(section,key),hashNormName(section,key));
+  }
+
+  /// Same as insert(section,key) with precomputed normName(section,key) and hashNormName(section,key)
+  int insert(std::string_view section, std::string_view key, std::string_view name, std::size_t hash)
+  {
+   int id=find(section,key);
+   if (id>=0) return id;
+   int sid=findSection(section);
+   if (sid<0)
+   {
+    sid=(int)sections.size();
+    sections.push_back(std::string(section));
+    sectionIndex.insert(hashString(section.data(),section.length()),sid);
+   }
+   records.push_back(ctkParamRecord());
+   ctkParamRecord& r=records.back();
+   r.section=sid;
+   r.key=strings.copy(key);
+   r.name=strings.copy(name);
+   r.data=0x0;
+   r.generation=0;
+   id=(int)records.size()-1;
+   recordIndex.insert(hash,id);
+   return id;
+  }
+
+  /// Make room for n parameters (eg. before declaring many at once)
+  void reserve(int n) { records.reserve(n); }
+
+  /// Number of bytes held by the registry for its records and their strings (excluding the parameters themselves)
+  std::size_t bytesReserved() const
+  {
+   return records.capacity()*sizeof(ctkParamRecord)+strings.bytesReserved();
+  }
+
+  /// Set the actual parameter of a record and start a new generation of it. Returns the previous one, if any.
+  ctkParamDataInterface* setData(int id, ctkParamDataInterface* data)
+  {
+   ctkParamDataInterface* old=records[id].data;
+   records[id].data=data;
+   records[id].generation++;
+   if (!old || !data) orderValid=false;
+   return old;
+  }
+
+  /// Ids of records with data sorted by section and key (the order in which parameters appear in ini-files, xml and help text)
+  const std::vector<int>& ordered() const
+  {
+   if (!orderValid)
+   {
+    order.clear();
+    for (int i=0;i<(int)records.size();i++)
+     if (records[i].data) order.push_back(i);
+    std::sort(order.begin(),order.end(), [&](int a, int b) {
+     const ctkParamRecord &ra=records[a], &rb=records[b];
+     if (ra.section!=rb.section) return sections[ra.section]<sections[rb.section];
+     return ra.key<rb.key;
+    });
+    orderValid=true;
+   }
+   return order;
+  }
+
+  /// Associate a command line flag with a record. Replaces a previous association of the same flag.
+  void setFlag(std::string_view flag, int id)
+  {
+   int fid=findFlagIndex(flag);
+   if (fid>=0)
+    flags[fid].second=id;
+   else
+   {
+    flagIndex.insert(hashString(flag.data(),flag.length()),(int)flags.size());
+    flags.push_back(std::make_pair(strings.copy(flag),id));
+   }
+   // flags "0", "1" etc. denote indexed parameters, which are looked up by number
+   if (!flag.empty() && flag.find_first_not_of("0123456789")==std::string_view::npos)
+   {
+    std::size_t index=0;
+    for (std::size_t i=0;i<flag.length();i++) index=index*10+(std::size_t)(flag[i]-'0');
+    if (index>=indexed.size()) indexed.resize(index+1,-1);
+    indexed[index]=id;
+   }
+  }
+
+  /// Index into the list of flags or -1 if unknown
+  int findFlagIndex(std::string_view flag) const
+  {
+   return flagIndex.find(hashString(flag.data(),flag.length()),
+    [&](int fid) { return flags[fid].first==flag; });
+  }
+
+  /// Id of the record associated with a command line flag or -1 if unknown
+  int findFlag(std::string_view flag) const
+  {
+   CTK_PROFILE_LOOKUP();
+   int fid=findFlagIndex(flag);
+   return fid<0 ? -1 : flags[fid].second;
+  }
+
+  /// Id of the record associated with an indexed command line argument or -1 if unknown
+  int findIndexed(int index) const
+  {
+   return index<0 || index>=(int)indexed.size() ? -1 : indexed[index];
+  }
+
+  /// One more than the largest index of an indexed command line argument
+  int numIndexed() const { return (int)indexed.size(); }
+ };
+
+} // namespace ctkCLI
+
+#endif // __ctkParamRegistry_h
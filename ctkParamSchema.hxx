@@ -0,0 +1,149 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) Lehrstuhl fuer Mustererkennung,
+    Universitaet Erlangen-Nuernberg
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#ifndef __ctkParamSchema_h
+#define __ctkParamSchema_h
+
+#include "ctkParam.hxx"
+
+#include <cstddef>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace ctkCLI {
+
+ /// A string of fixed length N, which can be built in constant expressions
+ template <std::size_t N>
+ struct ctkFixedString
+ {
+  char str[N+1];
+  constexpr std::string_view view() const { return std::string_view(str,N); }
+ };
+
+ /// The long command line flag of a parameter at compile time: "--" followed by the normalized name (see normName)
+ template <std::size_t N1, std::size_t N2>
+ constexpr ctkFixedString<N1+N2+1> staticLongFlag(const char (&section)[N1], const char (&key)[N2])
+ {
+  ctkFixedString<N1+N2+1> flag{};
+  std::size_t n=0;
+  flag.str[n++]='-';
+  flag.str[n++]='-';
+  for (std::size_t i=0;i+1<N1;i++) flag.str[n++]=normChar(section[i]);
+  flag.str[n++]='-';
+  for (std::size_t i=0;i+1<N2;i++) flag.str[n++]=normChar(key[i]);
+  flag.str[n]=0;
+  return flag;
+ }
+
+ /// How the default value of a static parameter of type T is given: as T for basic numbers, as text otherwise.
+ template <typename T> struct ctkStaticDefault { typedef std::string_view type; };
+ template <> struct ctkStaticDefault<bool> { typedef bool type; };
+ template <> struct ctkStaticDefault<int> { typedef int type; };
+ template <> struct ctkStaticDefault<float> { typedef float type; };
+ template <> struct ctkStaticDefault<double> { typedef double type; };
+
+ template <typename T> inline void assignDefault(T& value, const T& in) { value=in; }
+ template <typename T> inline void assignDefault(T& value, std::string_view in) { stringTo(in,value); }
+
+ /**
+  * \ingroup Command Line Module
+  *
+  * A parameter described at compile time.
+  *
+  * Normalized name, command line flags and their hash are constant expressions,
+  * so declaring the parameter in ctkCmdLineApplication::declare(...) does no
+  * string processing. Data is the ctkParamData class, which holds the value,
+  * such as ctkParamData<int> or ctkParamDataFile.
+  *
+  * Use the macros CTK_STATIC_PARAM and CTK_STATIC_PARAM_OF:<br>
+  *   CTK_STATIC_PARAM(MaxIter, int, "Algorithm", "Max Iteration", 100, "Maximum number of iterations", "i")<br>
+  *   CTK_STATIC_PARAM_OF(Input, File, "Input", "Image", "", "The image to process", "")<br>
+  *   ...<br>
+  *   ctkApp.declare(MaxIter, Input);<br>
+  *   for (int i=0;i<MaxIter.ref();i++) ...<br>
+  *   other.declare(MaxIter); // another ctkCmdLineApplication<br>
+  *   int otherMaxIter=MaxIter.ref(other);<br>
+  **/
+ template <typename Data>
+ struct ctkStaticParam
+ {
+  typedef typename std::remove_reference<decltype(std::declval<Data&>().value)>::type value_type;
+
+  std::string_view section;
+  std::string_view key;
+  /// "--" followed by the normalized name
+  std::string_view longflag;
+  /// The normalized name
+  std::string_view name;
+  /// The hash of the normalized name, as used by ctkParamRegistry
+  std::size_t hash;
+  typename ctkStaticDefault<value_type>::type defaultValue;
+  std::string_view description;
+  /// Single character or empty
+  std::string_view shortflag;
+
+  template <std::size_t N>
+  constexpr ctkStaticParam(std::string_view s, std::string_view k, const ctkFixedString<N>& flag,
+   typename ctkStaticDefault<value_type>::type def, std::string_view desc, std::string_view shortf)
+   : section(s), key(k), longflag(flag.view()), name(flag.view().substr(2)),
+     hash(hashString(flag.str+2,N-2)), defaultValue(def), description(desc), shortflag(shortf)
+  {}
+
+  /// Add this parameter to app, set its default value and command line flags. Returns its id.
+  int declareIn(ctkCmdLineApplication& app) const
+  {
+   CTK_PROFILE_PHASE(app.getProfile(),"declare");
+   Data *p=new Data;
+   assignDefault(p->value,defaultValue);
+   p->tags["name"]=std::string(name);
+   p->tags["longflag"]=std::string(name);
+   p->tags["description"]=std::string(description);
+   if (!shortflag.empty())
+    p->tags["flag"]=std::string(shortflag);
+   int id=app.setParam(section,key,name,hash,p);
+   app.setFlag(longflag,id);
+   if (!shortflag.empty())
+    app.setFlag(std::string("-")+std::string(shortflag),id);
+   return id;
+  }
+
+  /// A bound handle to this parameter, as declared in app (see declareIn and ctkParamRef)
+  ctkParamRef<value_type> ref(ctkCmdLineApplication& app=ctkApp) const { return ctkParamRef<value_type>(app,section,key); }
+ };
+
+} // namespace ctkCLI
+
+/// Define a constant NAME, which describes a parameter of basic TYPE (see ctkCLI::ctkStaticParam)
+#define CTK_STATIC_PARAM(NAME,TYPE,SECTION,KEY,DEFAULT,DESCRIPTION,SHORTFLAG)                 \
+ constexpr ctkCLI::ctkFixedString<sizeof(SECTION)+sizeof(KEY)+1> NAME##LongFlag=                 \
+  ctkCLI::staticLongFlag(SECTION,KEY);                                                           \
+ constexpr ctkCLI::ctkStaticParam<ctkCLI::ctkParamData<TYPE> > NAME(SECTION,KEY,NAME##LongFlag,  \
+  DEFAULT,DESCRIPTION,SHORTFLAG);
+
+/// Define a constant NAME, which describes a parameter of a special type, eg. File for ctkParamFile (see ctkCLI::ctkStaticParam)
+#define CTK_STATIC_PARAM_OF(NAME,SPECIAL,SECTION,KEY,DEFAULT,DESCRIPTION,SHORTFLAG)           \
+ constexpr ctkCLI::ctkFixedString<sizeof(SECTION)+sizeof(KEY)+1> NAME##LongFlag=                 \
+  ctkCLI::staticLongFlag(SECTION,KEY);                                                           \
+ constexpr ctkCLI::ctkStaticParam<ctkCLI::ctkParamData##SPECIAL> NAME(SECTION,KEY,NAME##LongFlag,\
+  DEFAULT,DESCRIPTION,SHORTFLAG);
+
+#endif // __ctkParamSchema_h
@@ -0,0 +1,276 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) Lehrstuhl fuer Mustererkennung,
+    Universitaet Erlangen-Nuernberg
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#ifndef __ctkParamSnapshot_h
+#define __ctkParamSnapshot_h
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "BinaryUtil.hxx"
+#include "FileUtil.hxx"
+
+namespace ctkCLI {
+
+ /**
+  * \ingroup Command Line Module
+  *
+  * An immutable copy of the values of all parameters of an application.
+  *
+  * The values are held in the binary parameter file format (see BinaryUtil.hxx)
+  * and are accessed by parameter id (see ctkCmdLineApplication::getParamId).
+  * They are either owned by the snapshot or read in place from a mapped file.
+  **/
+ class ctkParamSnapshot
+ {
+  std::string contents;
+  std::unique_ptr<ctkMappedFile> file;
+  ctkBinaryReader reader;
+  bool good;
+  /// Index of the entry in reader by parameter id or -1
+  std::vector<int> entries;
+
+  ctkParamSnapshot(const ctkParamSnapshot&);
+  ctkParamSnapshot& operator=(const ctkParamSnapshot&);
+
+  template <typename Names> void index(std::string_view binary, const Names& names)
+  {
+   good=reader.open(binary);
+   entries.resize(names.size(),-1);
+   for (std::size_t id=0;id<names.size();id++)
+    entries[id]=reader.find(names[id]);
+  }
+
+ public:
+  /// An empty snapshot
+  ctkParamSnapshot() : good(true) {}
+
+  /// Snapshot of the contents of a binary parameter file. names[id] is the normalized name of parameter id.
+  template <typename Names>
+  ctkParamSnapshot(std::string binary, const Names& names) : contents(std::move(binary))
+  {
+   index(contents,names);
+  }
+
+  /// Snapshot of a binary parameter file, which is read in place as long as the snapshot lives (see ctkMappedFile)
+  template <typename Names>
+  ctkParamSnapshot(std::unique_ptr<ctkMappedFile> mapped, const Names& names) : file(std::move(mapped))
+  {
+   index(file->data(),names);
+  }
+
+  /// False, if the contents are not a valid binary parameter file
+  bool is_valid() const { return good; }
+
+  /// Counts the snapshots published by an application
+  std::uint64_t generation() const { return reader.generation(); }
+
+  /// Number of parameters when the snapshot was taken
+  int size() const { return (int)entries.size(); }
+
+  /// Get the value of parameter id. Returns false if it did not exist or is not exactly of type T (or stored as text).
+  template <typename T> bool get(int id, T& value) const
+  {
+   if (id<0 || id>=(int)entries.size() || entries[id]<0) return false;
+   int e=entries[id];
+   if (reader.type(e)==binaryType<T>()) return binaryRead(reader.value(e),value);
+   return reader.type(e)==0 && stringTo(reader.value(e),value);
+  }
+
+  /// The binary representation of the value of parameter id and its type code (see binaryRead). Returns false if it did not exist.
+  bool getBinary(int id, int& type, std::string_view& value) const
+  {
+   if (id<0 || id>=(int)entries.size() || entries[id]<0) return false;
+   type=reader.type(entries[id]);
+   value=reader.value(entries[id]);
+   return true;
+  }
+
+  /// The contents in the binary parameter file format
+  std::string_view data() const { return contents; }
+ };
+
+ /**
+  * \ingroup Command Line Module
+  *
+  * Reclamation of published snapshots in the style of read-copy-update (RCU) with epochs.
+  *
+  * Readers announce the current epoch in a slot of their own while they hold a
+  * snapshot, which takes only atomic loads and stores. A writer replaces the
+  * current snapshot atomically and deletes old ones once no reader can hold them.
+  *
+  * Each thread takes one of maxReaders slots on first use and returns it on exit.
+  * Threads beyond this limit are counted instead. While any of them holds a snapshot,
+  * writers reclaim nothing. Readers never take a lock, so guards may be nested.
+  * A thread must not publish while it holds a ctkSnapshotGuard of the same domain.
+  **/
+ class ctkSnapshotDomain
+ {
+ public:
+  static const int maxReaders=128;
+
+  /// The slot of the current thread, the same for all domains, or -1 if all are taken
+  static int threadSlot()
+  {
+   static std::atomic<bool> taken[maxReaders];
+   struct Slot
+   {
+    int index;
+    Slot() : index(-1)
+    {
+     for (int i=0;i<maxReaders && index<0;i++)
+     {
+      bool expected=false;
+      if (taken[i].compare_exchange_strong(expected,true)) index=i;
+     }
+    }
+    ~Slot() { if (index>=0) taken[index].store(false); }
+   };
+   thread_local Slot slot;
+   return slot.index;
+  }
+
+ private:
+  /// Epoch announced by each reader slot or 0 if it holds no snapshot. Padded to avoid false sharing.
+  struct alignas(64) Reader
+  {
+   std::atomic<std::uint64_t> epoch;
+   /// Nesting of guards, only accessed by the owning thread
+   int depth;
+   Reader() : epoch(0), depth(0) {}
+  };
+  Reader readers[maxReaders];
+  std::atomic<std::uint64_t> epoch;
+  std::atomic<const ctkParamSnapshot*> current;
+  /// Number of snapshots held by readers without a slot
+  std::atomic<int> slotlessReaders;
+  /// Held by writers
+  std::mutex writers;
+  /// Replaced snapshots and the epoch in which they were replaced
+  std::vector<std::pair<std::uint64_t,const ctkParamSnapshot*> > retired;
+
+  ctkSnapshotDomain(const ctkSnapshotDomain&);
+  ctkSnapshotDomain& operator=(const ctkSnapshotDomain&);
+
+  /// Delete retired snapshots older than the oldest epoch announced by any reader. Requires the writers lock.
+  void reclaim()
+  {
+   // readers without a slot may hold any snapshot
+   if (slotlessReaders.load()>0)
+    return;
+   std::uint64_t oldest=epoch.load();
+   for (int i=0;i<maxReaders;i++)
+   {
+    std::uint64_t e=readers[i].epoch.load();
+    if (e && e<oldest) oldest=e;
+   }
+   std::size_t kept=0;
+   for (std::size_t i=0;i<retired.size();i++)
+    if (retired[i].first<oldest) delete retired[i].second;
+    else retired[kept++]=retired[i];
+   retired.resize(kept);
+  }
+
+ public:
+  ctkSnapshotDomain() : epoch(1), current(new ctkParamSnapshot), slotlessReaders(0) {}
+  ~ctkSnapshotDomain()
+  {
+   delete current.load();
+   for (std::size_t i=0;i<retired.size();i++)
+    delete retired[i].second;
+  }
+
+  /// Replace the current snapshot. Takes ownership. Safe to call from any thread, which does not hold a snapshot of this domain.
+  void publish(const ctkParamSnapshot* snapshot)
+  {
+   std::lock_guard<std::mutex> lock(writers);
+   const ctkParamSnapshot* old=current.exchange(snapshot);
+   // readers, which still see old, have announced this epoch or an earlier one
+   retired.push_back(std::make_pair(epoch.fetch_add(1),old));
+   reclaim();
+  }
+
+  /// Access the current snapshot. Must be paired with release() by the same thread.
+  const ctkParamSnapshot* acquire()
+  {
+   int slot=threadSlot();
+   if (slot<0)
+   {
+    // announced before the snapshot is loaded, so that a writer which replaces it afterwards keeps it
+    slotlessReaders.fetch_add(1);
+    return current.load();
+   }
+   Reader& r=readers[slot];
+   if (r.depth++==0)
+    r.epoch.store(epoch.load());
+   return current.load();
+  }
+
+  /// The snapshot returned by acquire() may be deleted after release
+  void release()
+  {
+   int slot=threadSlot();
+   if (slot<0)
+   {
+    slotlessReaders.fetch_sub(1);
+    return;
+   }
+   Reader& r=readers[slot];
+   if (--r.depth==0)
+    r.epoch.store(0);
+  }
+ };
+
+ /**
+  * \ingroup Command Line Module
+  *
+  * Holds the current snapshot of a ctkSnapshotDomain during its lifetime.
+  *
+  * Syntax example (eg. within a worker thread):<br>
+  *   ctkCLI::ctkSnapshotGuard snapshot=ctkApp.published();<br>
+  *   double speed=0;<br>
+  *   snapshot->get(speedId,speed);<br>
+  **/
+ class ctkSnapshotGuard
+ {
+  ctkSnapshotDomain& domain;
+  const ctkParamSnapshot* snapshot;
+
+  ctkSnapshotGuard(const ctkSnapshotGuard&);
+  ctkSnapshotGuard& operator=(const ctkSnapshotGuard&);
+
+ public:
+  ctkSnapshotGuard(ctkSnapshotDomain& d) : domain(d), snapshot(d.acquire()) {}
+  ~ctkSnapshotGuard() { domain.release(); }
+
+  const ctkParamSnapshot& operator*() const { return *snapshot; }
+  const ctkParamSnapshot* operator->() const { return snapshot; }
+ };
+
+} // namespace ctkCLI
+
+#endif // __ctkParamSnapshot_h
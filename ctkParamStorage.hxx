@@ -0,0 +1,234 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) Lehrstuhl fuer Mustererkennung,
+    Universitaet Erlangen-Nuernberg
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#ifndef __ctkParamStorage_h
+#define __ctkParamStorage_h
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ctkCLI {
+
+ /**
+  * \ingroup Command Line Module
+  *
+  * Bump allocator for objects which live about as long as the application, such as parameters.
+  *
+  * Memory is taken from large blocks, which are only released when the arena is destroyed.
+  * Deallocated memory is kept in free lists by size and reused by allocations of the same size.
+  * Thus a new object often has the address of one just deallocated: addresses do not identify objects over time.
+  * Not thread-safe: parameters are expected to be declared by one thread.
+  **/
+ class ctkArena
+ {
+  /// Allocations are aligned to this unless requested otherwise. Only those are reused after deallocate.
+  static constexpr std::size_t granularity=alignof(std::max_align_t);
+  /// Blocks start small and grow up to this size, so that small apps do not reserve much
+  static constexpr std::size_t maxBlockSize=64*1024;
+
+  std::vector<char*> blocks;
+  /// Free space in the current block
+  char* next;
+  std::size_t left;
+  std::size_t blockSize;
+  /// Heads of singly linked lists of freed memory by size/granularity
+  std::vector<void*> freeLists;
+  std::size_t reserved;
+
+  ctkArena(const ctkArena&);
+  ctkArena& operator=(const ctkArena&);
+
+  static std::size_t roundUp(std::size_t n) { return n ? (n+granularity-1)/granularity*granularity : granularity; }
+
+ public:
+  ctkArena() : next(0x0), left(0), blockSize(4096), reserved(0) {}
+  ~ctkArena()
+  {
+   for (std::size_t i=0;i<blocks.size();i++)
+    ::operator delete(blocks[i]);
+  }
+
+  /// Memory for n bytes. align must be a power of two no larger than granularity.
+  void* allocate(std::size_t n, std::size_t align=granularity)
+  {
+   if (align==granularity)
+   {
+    n=roundUp(n);
+    std::size_t c=n/granularity;
+    if (c<freeLists.size() && freeLists[c])
+    {
+     void* p=freeLists[c];
+     std::memcpy(&freeLists[c],p,sizeof(void*));
+     return p;
+    }
+   }
+   std::size_t pad=(align-(std::size_t)((std::uintptr_t)next%align))%align;
+   if (n+pad>left)
+   {
+    // large allocations get a block of their own, the current block stays in use
+    std::size_t size=std::max(n,blockSize);
+    if (blockSize<maxBlockSize) blockSize*=2;
+    char* block=static_cast<char*>(::operator new(size));
+    blocks.push_back(block);
+    reserved+=size;
+    if (size-n>left)
+    {
+     next=block+n;
+     left=size-n;
+    }
+    return block;
+   }
+   void* p=next+pad;
+   next+=n+pad;
+   left-=n+pad;
+   return p;
+  }
+
+  /// Return memory of n bytes obtained through allocate(n) (with default alignment) for reuse
+  void deallocate(void* p, std::size_t n)
+  {
+   if (!p) return;
+   std::size_t c=roundUp(n)/granularity;
+   if (c>=freeLists.size()) freeLists.resize(c+1,0x0);
+   std::memcpy(p,&freeLists[c],sizeof(void*));
+   freeLists[c]=p;
+  }
+
+  /// A copy of s within the arena. The characters are null terminated.
+  std::string_view copy(std::string_view s)
+  {
+   char* p=static_cast<char*>(allocate(s.length()+1,1));
+   if (!s.empty()) std::memcpy(p,s.data(),s.length());
+   p[s.length()]=0;
+   return std::string_view(p,s.length());
+  }
+
+  /// Number of bytes obtained from the system
+  std::size_t bytesReserved() const { return reserved; }
+ };
+
+ /// The arena all ctkParamData objects are allocated in (see ctkParamDataInterface::operator new). It is never destroyed.
+ inline ctkArena& paramArena()
+ {
+  static ctkArena* arena=new ctkArena;
+  return *arena;
+ }
+
+ /// Guards the paramArena() against instances of ctkCmdLineApplication in different threads
+ inline std::mutex& paramArenaMutex()
+ {
+  static std::mutex* mutex=new std::mutex;
+  return *mutex;
+ }
+
+ /// Serializes the conversion of text set in lazy mode (see ctkParamValue::get), so that threads may read a parameter concurrently.
+ /// Shared by all parameters, since each one converts at most once per value set.
+ inline std::mutex& lazyConversionMutex()
+ {
+  static std::mutex* mutex=new std::mutex;
+  return *mutex;
+ }
+
+ /**
+  * \ingroup Command Line Module
+  *
+  * Flat replacement of std::map<std::string,std::string> for the few tags, attributes
+  * and constraints of a parameter: a vector of key/value pairs sorted by key.
+  *
+  * Supports the subset of the interface of std::map used for such metadata.
+  * Unlike std::map, iterators are invalidated by insertion.
+  **/
+ class ctkStringMap
+ {
+ public:
+  typedef std::pair<std::string,std::string> value_type;
+  typedef std::vector<value_type>::iterator iterator;
+  typedef std::vector<value_type>::const_iterator const_iterator;
+
+ private:
+  std::vector<value_type> items;
+
+  iterator lowerBound(std::string_view key)
+  {
+   return std::lower_bound(items.begin(),items.end(),key,
+    [](const value_type& item, std::string_view k) { return item.first<k; });
+  }
+  const_iterator lowerBound(std::string_view key) const
+  {
+   return std::lower_bound(items.begin(),items.end(),key,
+    [](const value_type& item, std::string_view k) { return item.first<k; });
+  }
+
+ public:
+  iterator begin() { return items.begin(); }
+  iterator end() { return items.end(); }
+  const_iterator begin() const { return items.begin(); }
+  const_iterator end() const { return items.end(); }
+  bool empty() const { return items.empty(); }
+  std::size_t size() const { return items.size(); }
+  void clear() { items.clear(); }
+
+  /// Value by key. An empty value is inserted, if the key does not exist yet.
+  std::string& operator[](std::string_view key)
+  {
+   iterator it=lowerBound(key);
+   if (it==items.end() || it->first!=key)
+   {
+    // most parameters have a name, a long flag and a description
+    if (items.empty()) items.reserve(3);
+    it=items.insert(lowerBound(key),value_type(std::string(key),std::string()));
+   }
+   return it->second;
+  }
+
+  iterator find(std::string_view key)
+  {
+   iterator it=lowerBound(key);
+   return it!=items.end() && it->first==key ? it : items.end();
+  }
+  const_iterator find(std::string_view key) const
+  {
+   const_iterator it=lowerBound(key);
+   return it!=items.end() && it->first==key ? it : items.end();
+  }
+
+  std::size_t count(std::string_view key) const { return find(key)!=items.end() ? 1 : 0; }
+
+  std::size_t erase(std::string_view key)
+  {
+   iterator it=find(key);
+   if (it==items.end()) return 0;
+   items.erase(it);
+   return 1;
+  }
+ };
+
+} // namespace ctkCLI
+
+#endif // __ctkParamStorage_h
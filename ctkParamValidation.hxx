@@ -0,0 +1,187 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) Lehrstuhl fuer Mustererkennung,
+    Universitaet Erlangen-Nuernberg
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#ifndef __ctkParamValidation_h
+#define __ctkParamValidation_h
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "StringUtil.hxx"
+#include "ctkParamStorage.hxx"
+
+namespace ctkCLI {
+
+ /**
+  * \ingroup Command Line Module
+  *
+  * The constraints of one parameter, compiled from the strings of its tags, attribs
+  * and constraints into typed checks of its value:
+  *
+  * - constraints "minimum" and "maximum" (eg. ctkParamDouble::setRange)
+  * - tag "enumeration" of enumeration types
+  * - attrib "fileExtensions" of file, image and geometry parameters
+  * - existence of the directory of directory parameters
+  *
+  * Values are checked in their string representation. Empty values are not checked.
+  **/
+ class ctkParamCheck
+ {
+  enum Number { NotNumeric, Integer, Float, Double };
+  Number number;
+  bool hasMinimum, hasMaximum;
+  double minimum, maximum;
+  /// Allowed values, normalized for numbers (see normalized)
+  std::unordered_set<std::string> enumeration;
+  /// Allowed file extensions in lower case, without leading "*" or "."
+  std::vector<std::string> extensions;
+  bool directory;
+
+  /// Numbers in their shortest representation, so that eg. "0.50" matches an enumeration item "0.5"
+  std::string normalized(std::string_view text) const
+  {
+   int i; float f; double d;
+   switch (number)
+   {
+    case Integer: return stringTo(text,i) ? toString(i) : std::string(text);
+    case Float:   return stringTo(text,f) ? toString(f) : std::string(text);
+    case Double:  return stringTo(text,d) ? toString(d) : std::string(text);
+    default:      return std::string(text);
+   }
+  }
+
+  static std::string lowerCase(std::string_view str)
+  {
+   std::string ret(str);
+   for (std::size_t i=0;i<ret.length();i++)
+    ret[i]=(char)std::tolower((unsigned char)ret[i]);
+   return ret;
+  }
+
+ public:
+  /// Id of the parameter within the ctkCmdLineApplication
+  int id;
+
+  /// Compile the checks of a parameter of type (see ctkParamDataInterface::getType)
+  ctkParamCheck(int i, const std::string& type, const ctkStringMap& tags, const ctkStringMap& attribs, const ctkStringMap& constraints)
+   : number(NotNumeric), hasMinimum(false), hasMaximum(false), minimum(0), maximum(0), directory(false), id(i)
+  {
+   std::string_view base=type;
+   if (base.length()>12 && base.substr(base.length()-12)=="-enumeration")
+    base=base.substr(0,base.length()-12);
+   if (base=="integer") number=Integer;
+   else if (base=="float") number=Float;
+   else if (base=="double") number=Double;
+   ctkStringMap::const_iterator it=constraints.find("minimum");
+   if (it!=constraints.end()) hasMinimum=stringTo(it->second,minimum);
+   it=constraints.find("maximum");
+   if (it!=constraints.end()) hasMaximum=stringTo(it->second,maximum);
+   it=tags.find("enumeration");
+   if (it!=tags.end() && type.length()>12 && type.substr(type.length()-12)=="-enumeration")
+   {
+    std::vector<std::string> items=stringToVector<std::string>(it->second,',');
+    for (std::size_t e=0;e<items.size();e++)
+     enumeration.insert(normalized(trimmed(items[e])));
+   }
+   it=attribs.find("fileExtensions");
+   if (it!=attribs.end() && (type=="file" || type=="image" || type=="geometry"))
+   {
+    std::vector<std::string> items=stringToVector<std::string>(it->second,',');
+    for (std::size_t e=0;e<items.size();e++)
+    {
+     std::string_view ext=trimmed(items[e]);
+     while (!ext.empty() && (ext[0]=='*' || ext[0]=='.')) ext.remove_prefix(1);
+     if (!ext.empty()) extensions.push_back(lowerCase(ext));
+    }
+   }
+   directory=type=="directory";
+  }
+
+  /// False, if no constraints apply to the parameter
+  bool any() const { return hasMinimum || hasMaximum || !enumeration.empty() || !extensions.empty() || directory; }
+
+  /// True, if the check requires access to the filesystem (see checkFilesystem)
+  bool filesystem() const { return directory; }
+
+  /// Check the value without accessing the filesystem. Returns a description of the violated constraint or an empty string.
+  std::string check(std::string_view text) const
+  {
+   if (text.empty()) return std::string();
+   if (hasMinimum || hasMaximum)
+   {
+    double d;
+    if (!stringTo(text,d)) return "not a number";
+    if (hasMinimum && d<minimum) return "less than minimum "+toString(minimum);
+    if (hasMaximum && d>maximum) return "greater than maximum "+toString(maximum);
+   }
+   if (!enumeration.empty() && enumeration.find(normalized(text))==enumeration.end())
+    return "not one of the enumeration";
+   if (!extensions.empty())
+   {
+    // compare with all extensions, so that eg. ".nii.gz" matches
+    std::string lower=lowerCase(text);
+    bool found=false;
+    for (std::size_t e=0;e<extensions.size() && !found;e++)
+     found=lower.length()>extensions[e].length() && lower[lower.length()-extensions[e].length()-1]=='.'
+        && lower.compare(lower.length()-extensions[e].length(),extensions[e].length(),extensions[e])==0;
+    if (!found) return "file extension not one of "+vectortoString(extensions,",");
+   }
+   return std::string();
+  }
+
+  /// Check the value against the filesystem (may be slow, eg. on network storage). Returns a description of the violated constraint or an empty string.
+  std::string checkFilesystem(const std::string& text) const
+  {
+   if (text.empty() || !directory) return std::string();
+   std::error_code error;
+   return std::filesystem::is_directory(text,error) ? std::string() : "no such directory";
+  }
+ };
+
+ /// Run checkFilesystem for the values of checks concurrently on up to threads threads. Returns the results by check.
+ inline std::vector<std::string> checkFilesystem(const std::vector<const ctkParamCheck*>& checks, const std::vector<std::string>& values, int threads)
+ {
+  std::vector<std::string> results(checks.size());
+  std::atomic<std::size_t> next(0);
+  auto work=[&]() {
+   for (std::size_t i=next++;i<checks.size();i=next++)
+    results[i]=checks[i]->checkFilesystem(values[i]);
+  };
+  int n=(int)std::min<std::size_t>(std::max(threads,1),checks.size());
+  std::vector<std::thread> pool;
+  for (int t=1;t<n;t++)
+   pool.push_back(std::thread(work));
+  work();
+  for (std::size_t t=0;t<pool.size();t++)
+   pool[t].join();
+  return results;
+ }
+
+} // namespace ctkCLI
+
+#endif // __ctkParamValidation_h
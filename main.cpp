@@ -23,8 +23,23 @@ int main(int argc, char ** argv)
  ctkParamDouble("Special","Slider").setRange(0,1);
  ctkParam<double>("Special","Slider")=0.333;
 
+ //// A ctkParamRef re-binds when its parameter is declared anew, even if the new one takes the address of the old one
+ {
+  ctkCmdLineApplication other("Ref Test", "Re-declares a parameter under a live ctkParamRef.");
+  ctkParamRef<int> x(other,"A","x");
+  x=3;
+  other.setParam("A","x",new ctkCLI::ctkParamDataEnumInt());
+  other.setParam("A","x",new ctkCLI::ctkParamData<float>());
+  if (x!=3)
+  {
+   std::cerr << "ctkParamRef<int> reads " << (int)x << " after its parameter was declared anew, instead of 3" << std::endl;
+   return 1;
+  }
+ }
+
  //// A simple parser of arguments in "--section-key value" format
- ctkApp.parseCommandLine(&argc,argv);
+ if (!ctkApp.parseCommandLine(&argc,argv))
+  return 1;
 
  ctkApp.save("test.ini");
  return 0;